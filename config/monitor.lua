@@ -86,6 +86,15 @@ observer.unrecognised_stream = function(e)
   io.flush()
 end
 
+-- This function is called when TCP reassembly has to skip over missing
+-- stream data.
+observer.tcp_gap = function(e)
+  local a = string.format("TCP gap (size is %d)", e.length)
+  observer.describe(e, a)
+  io.write("\n")
+  io.flush()
+end
+
 -- This function is called when an ICMP message is observed.
 observer.icmp = function(e)
   local a = string.format("ICMP (type %d, class %d)", e.type, e.code)
@@ -213,6 +222,17 @@ observer.http_response = function(e)
 
 end
 
+-- This function is called with each piece of an HTTP body, when body chunk
+-- delivery is on.
+observer.http_body = function(e)
+  local a = string.format("HTTP body (position %d, size is %d%s)",
+    e.position, #e.body, e.final and ", final" or "")
+  observer.describe(e, a)
+  io.write(string.format("    URL %s\n", e.url))
+  io.write("\n")
+  io.flush()
+end
+
 -- This function is called when an SMTP command is observed.
 observer.smtp_command = function(e)
   local a = string.format("SMTP command %s", e.command)
@@ -608,6 +628,8 @@ observer.event_handlers = {
   connection_down = observer.connection_down,
   unrecognised_datagram = observer.unrecognised_datagram,
   unrecognised_stream = observer.unrecognised_stream,
+  tcp_gap = observer.tcp_gap,
+  http_body = observer.http_body,
   icmp = observer.icmp,
   imap = observer.imap,
   imap_ssl = observer.imap_ssl,
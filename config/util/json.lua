@@ -185,6 +185,16 @@ module.unrecognised_stream = function(e)
   submit(obs)
 end
 
+-- This function is called when TCP reassembly has to skip over missing
+-- stream data.
+module.tcp_gap = function(e)
+  local obs = initialise_observation(e)
+  obs["action"] = "tcp_gap"
+  obs["tcp_gap"] = {}
+  obs["tcp_gap"]["length"] = e.length
+  submit(obs)
+end
+
 -- This function is called when an ICMP message is observed.
 module.icmp = function(e)
   local obs = initialise_observation(e)
@@ -218,6 +228,19 @@ module.http_response = function(e)
   submit(obs)
 end
 
+-- This function is called with each piece of an HTTP body, when body chunk
+-- delivery is on.
+module.http_body = function(e)
+  local obs = initialise_observation(e)
+  obs["action"] = "http_body"
+  obs["url"] = e.url
+  obs["http_body"] = {}
+  obs["http_body"]["position"] = e.position
+  obs["http_body"]["final"] = e.final
+  obs["http_body"]["body"] = b64(e.body)
+  submit(obs)
+end
+
 -- This function is called when a DNS message is observed.
 module.dns_message = function(e)
 
@@ -379,7 +402,10 @@ end
 module.smtp_data = function(e)
   local obs = initialise_observation(e)
   obs["action"] = "smtp_data"
-  obs["smtp_data"] = { from=e.from, to=e.to, body=e.data }
+  obs["smtp_data"] = { from=e.from, to=e.to, body=e.data, sha256=e.sha256 }
+  if e.length > #e.data then
+    obs["smtp_data"]["length"] = e.length
+  end
   submit(obs)
 end
 
@@ -481,7 +507,7 @@ end
 module.tls_client_hello = function(e)
   local obs = initialise_observation(e)
   obs["action"] = "tls_client_hello"
-  tls = { version=e.version, session_id=e.session_id}
+  tls = { version=e.version, session_id=e.session_id, ja3=e.ja3, ja4=e.ja4}
   tls["random"] = {timestamp=e.random_timestamp, data=str_to_hex(e.random_data)}
 
   cs = {}
@@ -540,7 +566,7 @@ end
 module.tls_server_hello = function(e)
   local obs = initialise_observation(e)
   obs["action"] = "tls_server_hello"
-  tls = { version=e.version, session_id=e.session_id}
+  tls = { version=e.version, session_id=e.session_id, ja3s=e.ja3s}
   tls["random"] = {timestamp=e.random_timestamp, data=str_to_hex(e.random_data)}
 
   -- the id is available too if needed (only used for unassigned currently)
@@ -711,6 +737,8 @@ module.event_handlers = {
   connection_down = module.connection_down,
   unrecognised_datagram = module.unrecognised_datagram,
   unrecognised_stream = module.unrecognised_stream,
+  tcp_gap = module.tcp_gap,
+  http_body = module.http_body,
   icmp = module.icmp,
   imap = module.imap,
   imap_ssl = module.imap_ssl,
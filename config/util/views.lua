@@ -0,0 +1,267 @@
+--
+-- Views of events through the LuaJIT FFI.  Fields are read in place from
+-- cybermon's buffers, so payloads and DNS records aren't copied into Lua
+-- strings or tables unless asked for.  Views are only valid during the
+-- config.event call which got the event, don't keep them.
+--
+-- Under other Lua implementations, module.available is false, use the
+-- event object as normal.
+--
+--   local views = require("util.views")
+--
+--   observer.event = function(e)
+--     local v = views.event(e)
+--     if v:action() == "dns_message" then
+--       for i = 1, v:dns_count(views.ANSWERS) do
+--         local rr = v:dns_record(views.ANSWERS, i)
+--         print(rr.name:string(), rr.type, #rr.rdaddress)
+--       end
+--     end
+--   end
+--
+
+local module = {}
+
+local ok, ffi = pcall(require, "ffi")
+if not ok then
+  module.available = false
+  return module
+end
+
+module.available = true
+
+-- Keep in step with include/cyberprobe/analyser/views.h.
+ffi.cdef[[
+typedef struct cybermon_event cybermon_event;
+typedef struct cybermon_context cybermon_context;
+
+typedef struct {
+  const uint8_t* ptr;
+  size_t len;
+} cybermon_bytes;
+
+typedef struct {
+  uint16_t id;
+  uint8_t qr;
+  uint8_t opcode;
+  uint8_t aa;
+  uint8_t tc;
+  uint8_t rd;
+  uint8_t ra;
+  uint8_t rcode;
+  uint16_t qdcount;
+  uint16_t ancount;
+  uint16_t nscount;
+  uint16_t arcount;
+} cybermon_dns_header;
+
+typedef struct {
+  cybermon_bytes name;
+  uint16_t type;
+  uint16_t cls;
+  uint32_t ttl;
+  cybermon_bytes rdata;
+  cybermon_bytes rdname;
+  cybermon_bytes rdaddress;
+} cybermon_dns_rr;
+
+const char* cybermon_action_name(int action);
+const char* cybermon_field_name(int field);
+const char* cybermon_context_kind_name(int kind);
+
+int cybermon_event_action(const cybermon_event* ev);
+double cybermon_event_time(const cybermon_event* ev);
+int cybermon_event_device(const cybermon_event* ev, cybermon_bytes* out);
+const cybermon_context* cybermon_event_context(const cybermon_event* ev);
+int cybermon_event_bytes(const cybermon_event* ev, int field,
+                         cybermon_bytes* out);
+
+int cybermon_event_dns_header(const cybermon_event* ev,
+                              cybermon_dns_header* out);
+size_t cybermon_event_dns_count(const cybermon_event* ev, int section);
+int cybermon_event_dns_record(const cybermon_event* ev, int section,
+                              size_t i, cybermon_dns_rr* out);
+
+size_t cybermon_event_tls_certificate_count(const cybermon_event* ev);
+int cybermon_event_tls_certificate(const cybermon_event* ev, size_t i,
+                                   cybermon_bytes* out);
+
+unsigned long cybermon_context_id(const cybermon_context* cx);
+int cybermon_context_kind(const cybermon_context* cx);
+const cybermon_context* cybermon_context_parent(const cybermon_context* cx);
+int cybermon_context_device(const cybermon_context* cx, cybermon_bytes* out);
+int cybermon_context_src(const cybermon_context* cx, cybermon_bytes* out);
+int cybermon_context_dest(const cybermon_context* cx, cybermon_bytes* out);
+]]
+
+local C = ffi.C
+
+-- DNS message sections.
+module.QUERIES = 0
+module.ANSWERS = 1
+module.AUTHORITIES = 2
+module.ADDITIONAL = 3
+
+-- Reads a name table from one of the name functions.
+local names = function(fn)
+  local t = {}
+  local i = 0
+  while true do
+    local n = fn(i)
+    if n == nil then break end
+    t[i] = ffi.string(n)
+    i = i + 1
+  end
+  return t
+end
+
+local actions = names(C.cybermon_action_name)
+local kinds = names(C.cybermon_context_kind_name)
+
+local fields = {}
+for num, name in pairs(names(C.cybermon_field_name)) do
+  fields[name] = num
+end
+
+local new_bytes = ffi.typeof("cybermon_bytes")
+local new_header = ffi.typeof("cybermon_dns_header")
+local new_rr = ffi.typeof("cybermon_dns_rr")
+
+-- Byte ranges.  Positions are 1-based, as for Lua strings.
+local bytes = {}
+bytes.__index = bytes
+
+bytes.__len = function(b)
+  return tonumber(b.len)
+end
+
+-- Copies bytes i to j into a Lua string, by default all of them.
+bytes.string = function(b, i, j)
+  local len = tonumber(b.len)
+  i = i or 1
+  j = j or len
+  if i < 1 then i = 1 end
+  if j > len then j = len end
+  if j < i then return "" end
+  return ffi.string(b.ptr + i - 1, j - i + 1)
+end
+
+-- Returns byte i, or nil.
+bytes.byte = function(b, i)
+  if i < 1 or i > b.len then return nil end
+  return b.ptr[i - 1]
+end
+
+ffi.metatype("cybermon_bytes", bytes)
+
+-- Events.
+local event = {}
+event.__index = event
+
+event.action = function(ev)
+  return actions[C.cybermon_event_action(ev)]
+end
+
+event.time = function(ev)
+  return C.cybermon_event_time(ev)
+end
+
+event.device = function(ev)
+  local b = new_bytes()
+  C.cybermon_event_device(ev, b)
+  return b
+end
+
+event.context = function(ev)
+  local cx = C.cybermon_event_context(ev)
+  if cx == nil then return nil end
+  return cx
+end
+
+-- A string or payload field by name e.g. "body", or nil.
+event.field = function(ev, name)
+  local f = fields[name]
+  if f == nil then return nil end
+  local b = new_bytes()
+  if C.cybermon_event_bytes(ev, f, b) == 0 then return nil end
+  return b
+end
+
+event.dns_header = function(ev)
+  local h = new_header()
+  if C.cybermon_event_dns_header(ev, h) == 0 then return nil end
+  return h
+end
+
+event.dns_count = function(ev, section)
+  return tonumber(C.cybermon_event_dns_count(ev, section))
+end
+
+-- Record i of a section, or nil.  If 'rr' is given, it is filled in and
+-- returned, so that a loop needn't allocate a record each time.
+event.dns_record = function(ev, section, i, rr)
+  rr = rr or new_rr()
+  if C.cybermon_event_dns_record(ev, section, i - 1, rr) == 0 then
+    return nil
+  end
+  return rr
+end
+
+event.certificate_count = function(ev)
+  return tonumber(C.cybermon_event_tls_certificate_count(ev))
+end
+
+event.certificate = function(ev, i)
+  local b = new_bytes()
+  if C.cybermon_event_tls_certificate(ev, i - 1, b) == 0 then
+    return nil
+  end
+  return b
+end
+
+ffi.metatype("struct cybermon_event", event)
+
+-- Contexts.
+local context = {}
+context.__index = context
+
+context.id = function(cx)
+  return tonumber(C.cybermon_context_id(cx))
+end
+
+context.kind = function(cx)
+  return kinds[C.cybermon_context_kind(cx)]
+end
+
+context.parent = function(cx)
+  local p = C.cybermon_context_parent(cx)
+  if p == nil then return nil end
+  return p
+end
+
+context.device = function(cx)
+  local b = new_bytes()
+  if C.cybermon_context_device(cx, b) == 0 then return nil end
+  return b
+end
+
+context.src = function(cx)
+  local b = new_bytes()
+  C.cybermon_context_src(cx, b)
+  return b
+end
+
+context.dest = function(cx)
+  local b = new_bytes()
+  C.cybermon_context_dest(cx, b)
+  return b
+end
+
+ffi.metatype("struct cybermon_context", context)
+
+-- Returns the view of an event object.
+module.event = function(e)
+  return ffi.cast("const cybermon_event*", e.handle)
+end
+
+return module
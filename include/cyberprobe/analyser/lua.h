@@ -329,6 +329,21 @@ delete[] buf;
 	    lua_pushlightuserdata(lua, val);
 	}
 
+	// Push a C function with 'n' upvalues, taken from the stack.
+	void push_c_closure(lua_CFunction f, int n) {
+	    lua_pushcclosure(lua, f, n);
+	}
+
+	// Pop a value into the registry, returning a reference to it.
+	int make_ref() {
+	    return luaL_ref(lua, LUA_REGISTRYINDEX);
+	}
+
+	// Push a value from the registry.
+	void get_ref(int ref) {
+	    lua_rawgeti(lua, LUA_REGISTRYINDEX, ref);
+	}
+
 	void to_string(int pos, std::string& s) {
 	    size_t len = 0;
 	    const char* c = lua_tolstring(lua, pos, &len);
@@ -470,6 +485,11 @@ delete[] buf;
     // Cybermon wrapper around the LUA state, acts as the cybermon to LUA
     // bridge.
     class lua : public lua_state {
+    private:
+
+	// Registry reference to config.event, which is called for every
+	// event.
+	int event_ref;
 
     public:
 
@@ -495,7 +515,12 @@ delete[] buf;
 
 	static int context_get_direction(lua_State*);
 
+	static int context_bypass(lua_State*);
+	static int context_get_bypass_counts(lua_State*);
+
         // Event methods
+	static int get_defrag_counts(lua_State*);
+
 	static int event_gc(lua_State*);
 	static int event_get_device(lua_State*);
 	static int event_get_action(lua_State*);
@@ -543,6 +568,10 @@ delete[] buf;
 	void push(const protocol::dns_rr&);
 	void push(const std::list<protocol::dns_rr>&);
 
+	// Push a section of a decoded message, as a table of queries or
+	// resource records.
+	void push(const protocol::dns_packet&, protocol::dns_section_t);
+
 	void to_dns_header(int pos, protocol::dns_header&);
 
 	void to_dns_query(int pos, protocol::dns_query&);
@@ -0,0 +1,125 @@
+
+// C interface to events and contexts, for the LuaJIT FFI.  Scripts see
+// event fields in place, as pointer and length views of the original
+// buffers, so that reading a payload or a DNS record doesn't copy it into
+// a Lua string or build a table.  config/util/views.lua repeats these
+// declarations for ffi.cdef, the two must be kept in step.
+//
+// Event and context pointers, and views, are only valid for the duration
+// of the config.event call which got the event.
+
+#ifndef CYBERPROBE_ANALYSER_VIEWS_H
+#define CYBERPROBE_ANALYSER_VIEWS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+
+    // Events and contexts are opaque.
+    typedef struct cybermon_event cybermon_event;
+    typedef struct cybermon_context cybermon_context;
+
+    // A byte range.
+    typedef struct {
+	const uint8_t* ptr;
+	size_t len;
+    } cybermon_bytes;
+
+    typedef struct {
+	uint16_t id;
+	uint8_t qr;
+	uint8_t opcode;
+	uint8_t aa;
+	uint8_t tc;
+	uint8_t rd;
+	uint8_t ra;
+	uint8_t rcode;
+	uint16_t qdcount;
+	uint16_t ancount;
+	uint16_t nscount;
+	uint16_t arcount;
+    } cybermon_dns_header;
+
+    // A DNS query or resource record.  Queries have no TTL or rdata.
+    typedef struct {
+	cybermon_bytes name;
+	uint16_t type;
+	uint16_t cls;
+	uint32_t ttl;
+	cybermon_bytes rdata;
+	cybermon_bytes rdname;
+	cybermon_bytes rdaddress;
+    } cybermon_dns_rr;
+
+    // DNS message sections.
+    enum {
+	CYBERMON_DNS_QUERIES,
+	CYBERMON_DNS_ANSWERS,
+	CYBERMON_DNS_AUTHORITIES,
+	CYBERMON_DNS_ADDITIONAL
+    };
+
+    // Action, field and context kind names, by number.  Null past the
+    // end.
+    const char* cybermon_action_name(int action);
+    const char* cybermon_field_name(int field);
+    const char* cybermon_context_kind_name(int kind);
+
+    int cybermon_event_action(const cybermon_event* ev);
+    double cybermon_event_time(const cybermon_event* ev);
+    int cybermon_event_device(const cybermon_event* ev, cybermon_bytes* out);
+
+    // Null for events with no context.
+    const cybermon_context* cybermon_event_context(const cybermon_event* ev);
+
+    // A string or payload field, by field number.  Returns 0 if the
+    // event has no such field.
+    int cybermon_event_bytes(const cybermon_event* ev, int field,
+			     cybermon_bytes* out);
+
+    // DNS messages.  Records are returned by index, in constant time.
+    // Names are decoded when a record is read.
+    int cybermon_event_dns_header(const cybermon_event* ev,
+				  cybermon_dns_header* out);
+    size_t cybermon_event_dns_count(const cybermon_event* ev, int section);
+    int cybermon_event_dns_record(const cybermon_event* ev, int section,
+				  size_t i, cybermon_dns_rr* out);
+
+    // TLS certificates.
+    size_t cybermon_event_tls_certificate_count(const cybermon_event* ev);
+    int cybermon_event_tls_certificate(const cybermon_event* ev, size_t i,
+				       cybermon_bytes* out);
+
+    unsigned long cybermon_context_id(const cybermon_context* cx);
+    int cybermon_context_kind(const cybermon_context* cx);
+
+    // Null for the root context.
+    const cybermon_context*
+    cybermon_context_parent(const cybermon_context* cx);
+
+    int cybermon_context_device(const cybermon_context* cx,
+				cybermon_bytes* out);
+    int cybermon_context_src(const cybermon_context* cx, cybermon_bytes* out);
+    int cybermon_context_dest(const cybermon_context* cx, cybermon_bytes* out);
+
+}
+
+namespace cyberprobe {
+
+namespace analyser {
+
+namespace views {
+
+    // Reuses the space for names decoded for the last event, called for
+    // each new event.
+    void reset();
+
+}
+
+}
+
+}
+
+#endif
+
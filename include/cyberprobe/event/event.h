@@ -85,10 +85,85 @@ namespace cyberprobe {
 	    TLS_CHANGE_CIPHER_SPEC,
 	    TLS_HANDSHAKE_FINISHED,
 	    TLS_HANDSHAKE_COMPLETE,
-	    TLS_APPLICATION_DATA
+	    TLS_APPLICATION_DATA,
+	    TCP_GAP,
+	    HTTP_BODY
 	};
 
 	std::string& action2string(action_type a);
+
+	// Event fields which Lua can read.  Field names are interned when
+	// the Lua state is created, so that reading a field is a table
+	// lookup and integer compares.
+	enum field {
+	    DEVICE_FIELD,
+	    ACTION_FIELD,
+	    TIME_FIELD,
+	    JSON_FIELD,
+	    PROTOBUF_FIELD,
+	    CONTEXT_FIELD,
+	    HANDLE_FIELD,
+	    ACKNOWLEDGEMENT_NUMBER_FIELD,
+	    ADDRESS_FIELD,
+	    ANSWERS_FIELD,
+	    BODY_FIELD,
+	    CALL_ID_FIELD,
+	    CERT_TYPES_FIELD,
+	    CIPHER_SUITE_FIELD,
+	    CIPHER_SUITES_FIELD,
+	    CODE_FIELD,
+	    COMMAND_FIELD,
+	    COMPRESSION_METHOD_FIELD,
+	    COMPRESSION_METHODS_FIELD,
+	    CONTENT_TYPE_FIELD,
+	    DATA_FIELD,
+	    DISTINGUISHED_NAMES_FIELD,
+	    DURATION_FIELD,
+	    EXTENSIONS_FIELD,
+	    FILT_ADDR_FIELD,
+	    FINAL_FIELD,
+	    FLAGS_FIELD,
+	    FRAG_NUM_FIELD,
+	    FROM_FIELD,
+	    HEADER_FIELD,
+	    JA3_FIELD,
+	    JA3S_FIELD,
+	    JA4_FIELD,
+	    KEY_FIELD,
+	    LENGTH_FIELD,
+	    MESSAGE_FIELD,
+	    METHOD_FIELD,
+	    NEXT_PROTO_FIELD,
+	    PAYLOAD_FIELD,
+	    PAYLOAD_LENGTH_FIELD,
+	    POSITION_FIELD,
+	    PRIVATE_FIELD,
+	    PROTECTED_FIELD,
+	    QUERIES_FIELD,
+	    RANDOM_DATA_FIELD,
+	    RANDOM_TIMESTAMP_FIELD,
+	    SEQ_NUM_FIELD,
+	    SEQUENCE_NUMBER_FIELD,
+	    SESSION_ID_FIELD,
+	    SHA256_FIELD,
+	    SIGNATURE_FIELD,
+	    SIGNATURE_ALGORITHM_FIELD,
+	    SIGNATURE_ALGORITHMS_FIELD,
+	    SPI_FIELD,
+	    STATUS_FIELD,
+	    SUBTYPE_FIELD,
+	    TEXT_FIELD,
+	    TIMESTAMP_FIELD,
+	    TO_FIELD,
+	    TYPE_FIELD,
+	    URL_FIELD,
+	    VAL_FIELD,
+	    VERSION_FIELD,
+	    NUM_FIELDS
+	};
+
+	// Field names, indexed by field.
+	extern const char* field_names[];
         
 	class event {
 	    static uuid_generator gen;
@@ -108,8 +183,7 @@ namespace cyberprobe {
 	    virtual std::string& get_action() const {
 		return action2string(action);
 	    }
-	    virtual int get_lua_value(analyser::lua&,
-				      const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual void to_json(std::string& doc) {
                 throw std::runtime_error("JSON not implemented.");
 	    }
@@ -10,6 +10,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <mutex>
 
 #include <cyberprobe/protocol/base_context.h>
 #include <cyberprobe/protocol/dns_protocol.h>
@@ -39,7 +40,7 @@ namespace cyberprobe {
 		    addr.to_string(address);
 		}
 	    virtual ~trigger_up() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual std::string get_device() const { return device; }
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -57,7 +58,7 @@ namespace cyberprobe {
 		device(device)
 		{}
 	    virtual ~trigger_down() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual std::string get_device() const { return device; }
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -79,7 +80,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~unrecognised_stream() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    int64_t position;
 	    virtual void to_json(std::string& doc) {
@@ -98,7 +99,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~connection_up() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
 	    }
@@ -115,7 +116,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~connection_down() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
 	    }
@@ -135,7 +136,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~unrecognised_datagram() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -158,7 +159,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~icmp() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    unsigned int type;
 	    unsigned int code;
 	    pdu payload;
@@ -181,7 +182,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~imap() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -202,7 +203,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~imap_ssl() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -223,7 +224,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~pop3() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -244,7 +245,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~pop3_ssl() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -265,7 +266,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~rtp() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -286,7 +287,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~rtp_ssl() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -307,7 +308,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~smtp_auth() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -328,7 +329,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~sip_ssl() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    pdu payload;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -352,7 +353,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~sip_request() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string method;
 	    const std::string from;
 	    const std::string to;
@@ -379,7 +380,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~sip_response() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    unsigned int code;
 	    const std::string status;
 	    const std::string from;
@@ -408,7 +409,7 @@ namespace cyberprobe {
 		    std::copy(s, e, body.begin());
 		}
 	    virtual ~http_request() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string method;
 	    const std::string url;
 	    http_hdr_t header;
@@ -436,7 +437,7 @@ namespace cyberprobe {
 		    std::copy(s, e, body.begin());
 		}
 	    virtual ~http_response() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    unsigned int code;
 	    const std::string status;
 	    http_hdr_t header;
@@ -458,7 +459,7 @@ namespace cyberprobe {
 		command(command)
 		{}
 	    virtual ~smtp_command() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string command;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -477,7 +478,7 @@ namespace cyberprobe {
 		status(status), text(text)
 		{}
 	    virtual ~smtp_response() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    int status;
 	    const std::list<std::string> text;
 	    virtual void to_json(std::string& doc) {
@@ -494,18 +495,31 @@ namespace cyberprobe {
 		      const std::list<std::string>& to,
 		      std::vector<unsigned char>::const_iterator s,
 		      std::vector<unsigned char>::const_iterator e,
+		      unsigned long length, const std::string& sha256,
 		      const timeval& time) :
 		protocol_event(SMTP_DATA, time, cp),
-		from(from), to(to)
+		from(from), to(to), length(length), sha256(sha256)
 		{
 		    body.resize(e - s);
 		    std::copy(s, e, body.begin());
 		}
 	    virtual ~smtp_data() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string from;
 	    const std::list<std::string> to;
+
+	    // Message body, up to the capture limit.
 	    pdu body;
+
+	    // Full length of the message, which is more than the body size
+	    // if the body was cut short by the capture limit.
+	    const unsigned long length;
+
+	    // SHA-256 of the full message, lower-case hex.  Empty unless
+	    // hashing is on.
+	    const std::string sha256;
+
+	    bool truncated() const { return length > body.size(); }
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
 	    }
@@ -523,7 +537,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~ftp_command() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string command;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -542,7 +556,7 @@ namespace cyberprobe {
 		status(status), text(text)
 		{}
 	    virtual ~ftp_response() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    int status;
 	    const std::list<std::string> text;
 	    virtual void to_json(std::string& doc) {
@@ -556,29 +570,36 @@ namespace cyberprobe {
 	class dns_message : public protocol_event {
 	public:
 	    dns_message(const context_ptr cp,
-			const protocol::dns_header& hdr,
-			const std::list<protocol::dns_query>& queries,
-			const std::list<protocol::dns_rr>& answers,
-			const std::list<protocol::dns_rr>& authorities,
-			const std::list<protocol::dns_rr>& additional,
+			protocol::dns_packet&& pkt,
 			const timeval& time) :
 		protocol_event(DNS_MESSAGE, time, cp),
-		header(hdr), queries(queries), answers(answers),
-		authorities(authorities), additional(additional)
+		header(pkt.hdr), packet(std::move(pkt))
 		{}
 	    virtual ~dns_message() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    protocol::dns_header header;
-	    std::list<protocol::dns_query> queries;
-	    std::list<protocol::dns_rr> answers;
-	    std::list<protocol::dns_rr> authorities;
-	    std::list<protocol::dns_rr> additional;
+
+	    // The message, with its records in arrays.
+	    const protocol::dns_packet packet;
+
+	    // The records as lists, made from the packet the first time
+	    // they're asked for.
+	    const std::list<protocol::dns_query>& queries() const;
+	    const std::list<protocol::dns_rr>& answers() const;
+	    const std::list<protocol::dns_rr>& authorities() const;
+	    const std::list<protocol::dns_rr>& additional() const;
+
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
 	    }
 #ifdef WITH_PROTOBUF
             virtual void to_protobuf(cyberprobe::Event& ev);
 #endif
+	private:
+	    void make_lists() const;
+	    mutable std::once_flag lists_made;
+	    mutable std::list<protocol::dns_query> query_list;
+	    mutable std::list<protocol::dns_rr> rr_lists[3];
 	};
     
 	class ntp_timestamp_message : public protocol_event {
@@ -590,7 +611,7 @@ namespace cyberprobe {
 		ts(ts)
 		{}
 	    virtual ~ntp_timestamp_message() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::ntp_timestamp ts;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -609,7 +630,7 @@ namespace cyberprobe {
 		ctrl(ctrl)
 		{}
 	    virtual ~ntp_control_message() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::ntp_control ctrl;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -629,7 +650,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~ntp_private_message() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::ntp_private priv;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -653,7 +674,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~gre() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string next_proto;
 	    const uint32_t key;
 	    const uint32_t sequence_no;
@@ -682,7 +703,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~gre_pptp() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string next_proto;
 	    const uint16_t payload_length;
 	    const uint16_t call_id;
@@ -710,7 +731,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~esp() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint32_t spi;
 	    const uint32_t sequence;
 	    const uint32_t payload_length;
@@ -737,7 +758,7 @@ namespace cyberprobe {
 		    std::copy(s, e, payload.begin());
 		}
 	    virtual ~unrecognised_ip_protocol() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint8_t next_proto;
 	    const uint32_t payload_length;
 	    pdu payload;
@@ -765,7 +786,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~wlan() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint8_t version;
 	    const uint8_t type;
 	    const uint8_t subtype;
@@ -794,7 +815,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_unknown() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string version;
 	    const uint8_t content_type;
 	    const uint16_t length;
@@ -816,7 +837,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_client_hello() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::tls_handshake_protocol::client_hello_data data;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -836,7 +857,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_server_hello() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::tls_handshake_protocol::server_hello_data data;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -874,7 +895,7 @@ namespace cyberprobe {
 		    certs.insert(certs.end(), crt.begin(), crt.end());
 		}
 	    virtual ~tls_certificates() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    std::vector<std::vector<uint8_t>> certs;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -894,7 +915,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_server_key_exchange() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::tls_handshake_protocol::key_exchange_data data;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -914,7 +935,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_handshake_generic() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint8_t type;
 	    const uint32_t len;
 	    virtual void to_json(std::string& doc) {
@@ -935,7 +956,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_certificate_request() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const protocol::tls_handshake_protocol::certificate_request_data data;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -955,7 +976,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_client_key_exchange() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::vector<uint8_t> key;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -978,7 +999,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_certificate_verify() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint8_t sig_hash_algo;
 	    const uint8_t sig_algo;
 	    const std::string sig;
@@ -999,7 +1020,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_change_cipher_spec() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const uint8_t val;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -1019,7 +1040,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_handshake_finished() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::vector<uint8_t> msg;
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
@@ -1037,7 +1058,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_handshake_complete() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    virtual void to_json(std::string& doc) {
 		jsonify(*this, doc);
 	    }
@@ -1057,7 +1078,7 @@ namespace cyberprobe {
 		{
 		}
 	    virtual ~tls_application_data() {}
-	    virtual int get_lua_value(analyser::lua&, const std::string& name);
+	    virtual int get_lua_value(analyser::lua&, field f);
 	    const std::string version;
 	    const std::vector<uint8_t> data;
 	    virtual void to_json(std::string& doc) {
@@ -1068,6 +1089,52 @@ namespace cyberprobe {
 #endif
 	};
 
+	// Stream data was lost, reassembly skipped over 'length' bytes.
+	class tcp_gap : public protocol_event {
+	public:
+	    tcp_gap(const context_ptr cp,
+		    unsigned long length,
+		    const timeval& time) :
+		protocol_event(TCP_GAP, time, cp), length(length)
+		{
+		}
+	    virtual ~tcp_gap() {}
+	    virtual int get_lua_value(analyser::lua&, field f);
+	    unsigned long length;
+	    virtual void to_json(std::string& doc) {
+		jsonify(*this, doc);
+	    }
+#ifdef WITH_PROTOBUF
+            virtual void to_protobuf(cyberprobe::Event& ev);
+#endif
+	};
+
+	// A piece of an HTTP request or response body, delivered as it
+	// arrives.  'position' is where it starts in the body.  The last
+	// piece of a body is marked 'final', and may be empty.
+	class http_body : public protocol_event {
+	public:
+	    http_body(const context_ptr cp, const std::string& url,
+		      unsigned long long position, bool final,
+		      pdu_iter s, pdu_iter e, const timeval& time) :
+		protocol_event(HTTP_BODY, time, cp),
+		url(url), position(position), final(final), body(s, e)
+		{
+		}
+	    virtual ~http_body() {}
+	    virtual int get_lua_value(analyser::lua&, field f);
+	    const std::string url;
+	    unsigned long long position;
+	    bool final;
+	    pdu body;
+	    virtual void to_json(std::string& doc) {
+		jsonify(*this, doc);
+	    }
+#ifdef WITH_PROTOBUF
+            virtual void to_protobuf(cyberprobe::Event& ev);
+#endif
+	};
+
     };
 
 };
@@ -63,6 +63,8 @@ namespace cyberprobe {
 	class tls_handshake_finished;
 	class tls_handshake_complete;
 	class tls_application_data;
+	class tcp_gap;
+	class http_body;
 
         typedef std::string pbuf;
 
@@ -113,6 +115,8 @@ namespace cyberprobe {
         void protobufify(const tls_handshake_finished& d, cyberprobe::Event&);
         void protobufify(const tls_handshake_complete& d, cyberprobe::Event&);
         void protobufify(const tls_application_data& d, cyberprobe::Event&);
+        void protobufify(const tcp_gap& d, cyberprobe::Event&);
+        void protobufify(const http_body& d, cyberprobe::Event&);
 
 	template<class C>
 	inline void protobufify(const C& d, pbuf& c) {
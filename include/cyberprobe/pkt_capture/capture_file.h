@@ -0,0 +1,143 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Capture file reader
+//
+// Streams packets from classic PCAP and pcapng files without libpcap.
+// Files compressed with gzip, zstd or lz4 are decompressed on the fly,
+// the format being recognised from the first bytes, so nothing is
+// written to disk.  Reading and decompression run on a thread of their
+// own, ahead of the caller, into a pool of large buffers.
+//
+// A pcapng file can hold packets from several interfaces, each with its
+// own link type and timestamp resolution, and several sections, each in
+// its own byte order.  Every packet is returned with the link type of
+// its interface.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CYBERMON_CAPTURE_FILE_H
+#define CYBERMON_CAPTURE_FILE_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cyberprobe {
+
+namespace pcap {
+
+class read_ahead;
+
+class capture_file {
+
+public:
+
+    // A packet.  'data' points into the reader, and is valid until the
+    // next call of next.
+    struct packet {
+        timeval tv;
+        uint32_t caplen;
+        uint32_t len;
+        int linktype;
+        const unsigned char* data;
+    };
+
+    // Size of each read-ahead buffer, and the number of them.
+    static const size_t chunk_size = 1048576;
+    static const unsigned int chunks = 8;
+
+    // Largest block or record accepted.  Anything bigger means the file
+    // is corrupt.
+    static const uint32_t max_block = 16777216;
+
+    // Opens a file, "-" for standard input.  Throws runtime_error if the
+    // file can't be opened, or isn't in a known format.
+    capture_file(const std::string& path);
+    ~capture_file();
+
+    capture_file(const capture_file&) = delete;
+    capture_file& operator=(const capture_file&) = delete;
+
+    // Returns the next packet, false at the end of the file.  Throws
+    // runtime_error if the file is corrupt.
+    bool next(packet& p);
+
+    // Waits up to 'ms' milliseconds for input.  True if next has bytes
+    // to read, or will find the end of the file, false if none came.
+    // next can still wait on a record that is only partly written.
+    bool wait(unsigned int ms);
+
+    // True if the file ended part way through a record or compressed
+    // frame.
+    bool truncated() const;
+
+    const std::string path;
+
+private:
+
+    // pcapng interface.  Timestamps are in units of 10^-exponent seconds,
+    // or 2^-exponent seconds if 'binary', offset by 'offset' seconds.
+    struct interface {
+        int linktype;
+        bool binary;
+        unsigned int exponent;
+        int64_t offset;
+    };
+
+    std::unique_ptr<read_ahead> input;
+
+    // Buffer being read, and position in it.
+    std::unique_ptr<unsigned char[]> chunk;
+    size_t chunk_len;
+    size_t chunk_pos;
+
+    // Bytes gathered from more than one buffer.
+    std::vector<unsigned char> staging;
+
+    bool cut;
+
+    bool ng;
+    bool swapped;
+
+    // Classic PCAP: nanosecond timestamps, and the link type.
+    bool nano;
+    int linktype;
+
+    // pcapng interfaces in the current section.
+    std::vector<interface> interfaces;
+
+    // Time of the last packet, given to pcapng simple packets, which
+    // have none.
+    timeval last;
+
+    // Returns the next n bytes, held together.  Valid until the next
+    // call.  Returns 0 at the end of the file.
+    const unsigned char* get(size_t n);
+
+    uint16_t get16(const unsigned char* p) const;
+    uint32_t get32(const unsigned char* p) const;
+
+    bool next_pcap(packet& p);
+    bool next_pcapng(packet& p);
+
+    // Reads a pcapng section header, following its block type.
+    void section();
+
+    void add_interface(const unsigned char* body, uint32_t len);
+
+    timeval timestamp(const interface& i, uint64_t t) const;
+
+    void corrupt(const std::string& what) const;
+
+};
+
+};
+
+};
+
+#endif
+
@@ -15,6 +15,8 @@
 #include <string.h>
 #include <sys/time.h>
 
+#include <cyberprobe/pkt_capture/capture_file.h>
+
 extern "C" {
 #include <pcap.h>
 #include <pcap-bpf.h>
@@ -43,6 +45,7 @@ private:
 
     // Packet filter state.
     struct bpf_program fltr;
+    bool filtering;
     packet_handler& handler;
 
 protected:
@@ -60,30 +63,57 @@ protected:
 public:
 
     // Constructor.
-    capture(packet_handler& h) : handler(h) {
+    capture(packet_handler& h) : filtering(false), handler(h) {
         p = 0; running = true;
     }
 
     // Destructor.
-    virtual ~capture() { if (p) pcap_close(p); p = 0; }
+    virtual ~capture() {
+        if (filtering) pcap_freecode(&fltr);
+        if (p) pcap_close(p);
+        p = 0;
+    }
 
     // Adds a filter to the capture class.  spec specifies a PCAP-style
     // filter statement.  See 'pcap' man-page.  Throws a runtime_error
     // exception if compilation fails.
     void add_filter(const std::string& spec) {
+        set_filter(spec);
+    }
+
+    // Compiles a filter and attaches it in place of any existing one.  The
+    // old filter stays in place if compilation fails, or the program is
+    // more than 'max_insns' instructions (0 = no limit), in which case a
+    // runtime_error exception is thrown.  An empty spec accepts
+    // everything.  Must not be called while packets are being read.
+    void set_filter(const std::string& spec, unsigned int max_insns = 0) {
+
+        struct bpf_program prog;
 
 	// Zero out the compilation filter.
-        memset((void*) &fltr, 0, sizeof(fltr));
+        memset((void*) &prog, 0, sizeof(prog));
 
 	// Compile the expression.
-	int ret = pcap_compile(p, &fltr, (char*) spec.c_str(), 1, 0);
+	int ret = pcap_compile(p, &prog, (char*) spec.c_str(), 1, 0);
 	if (ret < 0)
 	    throw std::runtime_error(pcap_geterr(p));
 
-	// Attach to PCAP handle.
-	ret = pcap_setfilter(p, &fltr);
-	if (ret < 0)
-	    throw std::runtime_error(pcap_geterr(p));
+        if (max_insns != 0 && prog.bf_len > max_insns) {
+            pcap_freecode(&prog);
+            throw std::runtime_error("Filter program too large");
+        }
+
+	// Attach to PCAP handle.  The kernel swaps filters in one go.
+	ret = pcap_setfilter(p, &prog);
+	if (ret < 0) {
+            std::string err = pcap_geterr(p);
+            pcap_freecode(&prog);
+	    throw std::runtime_error(err);
+        }
+
+        if (filtering) pcap_freecode(&fltr);
+        fltr = prog;
+        filtering = true;
 
     }
 
@@ -175,23 +205,56 @@ public:
 
 };
 
-// File reader
+// File reader.  Reads classic PCAP and pcapng, compressed or not, see
+// capture_file.h.  Filters are not applied to files.
 class reader : public capture {
 
+private:
+    capture_file file;
+
+    // Link type of the packet being handled, as a DLT value.
+    int linktype;
+
 public:
 
-    // Constructor.  'iface' is the interface name e.g. eth0
-    // snaplen = maximum packet size to capture.
-    reader(packet_handler& h, const std::string& path) : capture(h) {
-	char errmsg[8192];
-	p = pcap_open_offline(path.c_str(), errmsg);
-	if (p == 0)
-	    throw std::runtime_error(errmsg);
-	pcap_set_snaplen(p, 65535);
-    }
+    // Constructor.  'path' is the file to read, "-" for standard input.
+    reader(packet_handler& h, const std::string& path) :
+        capture(h), file(path), linktype(DLT_EN10MB) {}
 
     virtual ~reader() {}
 
+    // Link type of the packet being handled.  In a pcapng file, this
+    // can change from packet to packet.
+    int datalink() const { return linktype; }
+
+    virtual void run() {
+
+        capture_file::packet pkt;
+
+        while (running) {
+
+            // Waits in short steps, so that stop is seen on an idle pipe.
+            if (!file.wait(500)) continue;
+
+            if (!file.next(pkt)) break;
+
+            // As libpcap, raw IP files are presented as DLT_RAW.
+            linktype = pkt.linktype == 101 ? DLT_RAW : pkt.linktype;
+
+            struct pcap_pkthdr hdr;
+            hdr.ts = pkt.tv;
+            hdr.caplen = pkt.caplen;
+            hdr.len = pkt.len;
+
+            handle_packet((unsigned char*) this, &hdr, pkt.data);
+
+        }
+
+        if (running && file.truncated())
+            std::cerr << file.path << ": Capture file truncated"
+                      << std::endl;
+
+    }
 
 };
 
@@ -10,36 +10,67 @@
 
 #include <cyberprobe/pkt_capture/packet_capture.h>
 #include <cyberprobe/probe/packet_consumer.h>
-
-#include <queue>
+#include <cyberprobe/probe/packet_ring.h>
+#include <cyberprobe/probe/stats.h>
+#include <cyberprobe/util/counter.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 namespace cyberprobe {
 
 namespace capture {
 
 class device {
+protected:
+
+    // Packets and bytes captured.
+    util::counter captured_packets;
+    util::counter captured_bytes;
+
 public:
     virtual ~device() {}
     virtual void stop() = 0;
     virtual void start() = 0;
     virtual void join() = 0;
 
+    // Delivers packets held for lookback to 'c'.  Nothing to do unless
+    // the device keeps a lookback buffer.
+    virtual void replay(packet_consumer& c) {}
+
+    // Restricts capture to packets which match the capture filter
+    // expression 'expr', describing the target set, so that untargeted
+    // packets can be dropped in the kernel.  Empty means no restriction.
+    // Devices which can't filter before user space ignore this.
+    virtual void set_target_filter(const std::string& expr) {}
+
+    // Reads the capture counters.
+    virtual void get_stats(probe::stats::interface_stats& s) {
+        s.packets = captured_packets.get();
+        s.bytes = captured_bytes.get();
+    }
+
 };
 
 using packet_handler = cyberprobe::pcap::packet_handler;
 
+// Delays packets before delivery, and optionally keeps delivered packets
+// for a lookback period so they can be replayed when a target is added.
+// Packets are held back to back in a fixed-size ring, if the ring fills
+// up, packets are released early.
 class delayline : public device {
 protected:
 
     // Handle to the deliver engine.
     packet_consumer& deliv;
 
-    struct delayed_packet {
-	std::vector<unsigned char> packet;
-	struct timeval exit_time;
-    };
-
     // Seconds of delay
     float delay;
 
@@ -50,49 +81,127 @@ protected:
     // Delay converted to timeval form.
     struct timeval delay_val;
 
-    std::queue<delayed_packet> delay_line;
+    // Seconds delivered packets are kept for replay.
+    float lookback;
+    struct timeval lookback_val;
+
+    // Ring size in bytes, and backing file if any.
+    uint64_t buffer_size;
+    std::string buffer_file;
+
+    // Delay line and lookback packets, created on first use.  Only the
+    // capture thread adds or delivers, replay is from other threads.
+    std::unique_ptr<packet_ring> ring;
+    std::mutex ring_mutex;
+
+    // Re-used for delivery.
+    std::vector<unsigned char> packet;
+
+    // Packets released before their delay was up, because the ring was
+    // full.
+    uint64_t early;
+
+    // Delivers the next waiting packet.  Caller holds ring_mutex.
+    void deliver_next();
+
+    // Discards lookback packets which are too old.  Caller holds
+    // ring_mutex.
+    void expire_lookback(const struct timeval& now);
+
+    static struct timeval to_timeval(float secs) {
+        struct timeval tv;
+        uint64_t usec = secs * 1000000;
+        tv.tv_usec = usec % 1000000;
+        tv.tv_sec = usec / 1000000;
+        return tv;
+    }
 
 public:
 
+    // Default ring size.
+    static const uint64_t default_buffer_size = 256 * 1024 * 1024;
+
     delayline(packet_consumer& deliv, float delay, int datalink) :
-        deliv(deliv), delay(delay), datalink(datalink) {
+        deliv(deliv), delay(delay), datalink(datalink), lookback(0.0),
+        buffer_size(default_buffer_size), early(0) {
 
         // Calculate delay in form of a timeval.
-        uint64_t delay_usec = delay * 1000000;
-        delay_val.tv_usec = delay_usec % 1000000;
-        delay_val.tv_sec = delay_usec / 1000000;
+        delay_val = to_timeval(delay);
+        lookback_val = to_timeval(0.0);
 
     }
 
     virtual ~delayline() {}
-        
+
+    // Sets the lookback period, and ring size and backing file.  Must be
+    // called before capture starts.
+    void set_buffer(float lookback, uint64_t size, const std::string& file) {
+        this->lookback = lookback;
+        lookback_val = to_timeval(lookback);
+        if (size != 0) buffer_size = size;
+        buffer_file = file;
+    }
+
     // Packet handler.
     virtual void handle(timeval tv, unsigned long len,
 			const unsigned char* bytes);
 
-    virtual void service_delayline() {
+    // Delivers packets whose delay is up.  Call from the capture thread,
+    // it's cheap when nothing is waiting.
+    virtual void service_delayline();
 
-	struct timeval now;
-	gettimeofday(&now, 0);
+    virtual void replay(packet_consumer& c);
 
-	while (!(delay_line.empty())) {
+    virtual void get_stats(probe::stats::interface_stats& s) {
+        device::get_stats(s);
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        s.early = early;
+    }
 
-	    if (delay_line.front().exit_time.tv_sec > now.tv_sec) break;
+};
 
-	    if ((delay_line.front().exit_time.tv_sec == now.tv_sec) &&
-		(delay_line.front().exit_time.tv_usec > now.tv_usec))
-		break;
+// A batch of packets stored back to back, with filter results.
+class packet_batch {
+public:
 
-	    // Packet ready to go.
-	    deliv.receive_packet(now, delay_line.front().packet, datalink);
-	    delay_line.pop();
+    // Batch number, batches are delivered in order.
+    uint64_t seq;
 
-	}
+    std::vector<unsigned char> data;
+
+    // Start of each packet in 'data', plus the end of the last one.
+    std::vector<size_t> offsets;
+
+    std::vector<struct timeval> times;
+
+    // Filter result per packet.
+    std::vector<char> pass;
 
+    packet_batch() : seq(0) { offsets.push_back(0); }
+
+    size_t size() const { return times.size(); }
+
+    void clear() {
+        data.clear();
+        offsets.resize(1);
+        times.clear();
+        pass.clear();
+    }
+
+    template<class C>
+    void add(const struct timeval& tv, C s, C e) {
+        data.insert(data.end(), s, e);
+        offsets.push_back(data.size());
+        times.push_back(tv);
     }
 
 };
 
+// A device which applies a capture filter in user space, for sources
+// which aren't captured through PCAP.  With a filter, packets are gathered
+// into batches on the capture thread, and filtered by a pool of worker
+// threads.  Filtered batches are handed back to the capture thread, in
+// order, for delivery.
 class filtering_device : public delayline {
 
 private:
@@ -100,10 +209,57 @@ private:
     pcap_t* p;
     bool filtering;
 
+    // Worker pool state.
+    std::mutex pool_mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    std::vector<std::thread*> workers;
+    bool pool_running;
+
+    // Batches waiting for a worker, and filtered batches waiting for
+    // delivery, by sequence number.
+    std::deque<std::shared_ptr<packet_batch> > todo;
+    std::map<uint64_t, std::shared_ptr<packet_batch> > done;
+
+    // Spare batches, for re-use.
+    std::vector<std::shared_ptr<packet_batch> > spare;
+
+    // Batch being filled, and the sequence numbers of the next batch
+    // to submit and to deliver.
+    std::shared_ptr<packet_batch> current;
+    std::chrono::steady_clock::time_point current_start;
+    uint64_t next_submit;
+    uint64_t next_deliver;
+
+    // Worker thread body.
+    void filter_worker();
+
+    // Filters a batch.
+    void filter_batch(packet_batch& b);
+
+    void start_workers();
+    void stop_workers();
+
 public:
 
+    // Packets in a batch.
+    static const unsigned int batch_size = 64;
+
+    // Filter worker threads.
+    static const unsigned int worker_threads = 2;
+
+    // Most batches in flight before the capture thread waits.
+    static const unsigned int max_batches = 32;
+
+    // Longest a packet waits in a partial batch, in microseconds, before
+    // the batch is sent for filtering anyway.
+    static const unsigned int max_batch_wait = 2000;
+
     filtering_device(packet_consumer& deliv, float delay, int datalink) :
-        delayline(deliv, delay, datalink) {
+        delayline(deliv, delay, datalink), pool_running(false),
+        next_submit(0), next_deliver(0) {
+
+        filtering = false;
 
         // Only used for filtering.
         p = pcap_open_dead(datalink, 65535);
@@ -112,12 +268,12 @@ public:
             return;
         }
 
-        filtering = false;
-
     }
 
     virtual ~filtering_device() {
 
+        stop_workers();
+
         if (filtering) {
             pcap_freecode(&fltr);
         }
@@ -128,6 +284,9 @@ public:
 
     virtual void add_filter(const std::string& spec) {
 
+        if (p == 0)
+	    throw std::runtime_error("Filter expression failed: no handle");
+
 	// Compile the expression.
 	int ret = pcap_compile(p, &fltr, (char*) spec.c_str(), 1, 0);
 
@@ -135,25 +294,24 @@ public:
 	    std::cerr << "Filter expression compilation failed" << std::endl;
 	    throw std::runtime_error(std::string("Filter expression failed: ") +
                                      pcap_geterr(p));
-	    pcap_close(p);
-	    return;
-
 	}
 
 	filtering = true;
 
+        start_workers();
+
     }
 
     template<class C>
     bool apply_filter(C s, C e) {
 
+        if (!filtering) return true;
+
         // Construct PCAP header for filter
         struct pcap_pkthdr hdr;
         hdr.caplen = e - s;
         hdr.len = e - s;
 
-        if (!filtering) return true;
-
         // Maybe apply filter
         if (pcap_offline_filter(&fltr, &hdr, &*s) != 0)
             return true;
@@ -162,6 +320,51 @@ public:
 
     }
 
+    // Takes a captured packet.  Without a filter, it's handled straight
+    // away, otherwise it's batched for filtering.  Capture thread only.
+    template<class C>
+    void submit(const struct timeval& tv, C s, C e) {
+
+        if (!filtering) {
+            handle(tv, e - s, &*s);
+            return;
+        }
+
+        if (!current) current = get_batch();
+
+        if (current->size() == 0)
+            current_start = std::chrono::steady_clock::now();
+
+        current->add(tv, s, e);
+
+        // Full, or the first packet has waited long enough.  Slow steady
+        // traffic would otherwise sit in the batch until it filled.
+        if (current->size() >= batch_size ||
+            std::chrono::steady_clock::now() - current_start >=
+            std::chrono::microseconds(max_batch_wait))
+            flush();
+
+    }
+
+    // Sends the partial batch for filtering.  Call when the source is
+    // idle.  Capture thread only.
+    void flush();
+
+    // Handles filtered batches which are next in order.  Capture thread
+    // only.
+    void drain();
+
+    // True if packets are batched or being filtered.  Capture thread only.
+    bool pending() {
+        if (current && current->size() != 0) return true;
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return next_submit != next_deliver;
+    }
+
+private:
+
+    std::shared_ptr<packet_batch> get_batch();
+
 };
 
 // Packet capture.  Captures on an interface, and then submits captured
@@ -173,19 +376,75 @@ private:
 
     std::thread* thr;
 
+    // Interface name.
+    std::string name;
+
+    // Most packets taken from PCAP between services of the delay line.
+    static const int dispatch_batch = 64;
+
+    // The filter is changed by the capture thread, between reads.  Other
+    // threads leave the new target expression here.
+    std::mutex filter_mutex;
+    std::string user_filter;
+    std::string target_filter;
+    std::atomic<bool> filter_changed;
+
+    // Builds and attaches the capture filter.
+    void apply_filter();
+
+    // Kernel counters, read from PCAP by the capture thread once a
+    // second.
+    time_t stats_time;
+    std::atomic<uint64_t> kernel_received;
+    std::atomic<uint64_t> kernel_dropped;
+    std::atomic<uint64_t> interface_dropped;
+    void read_kernel_stats();
+
+    // CPU the capture thread runs on, -1 = any.
+    int cpu;
+
 public:
 
+    // Largest BPF program used for target filtering, bigger than this and
+    // matching is left to user space.
+    static const unsigned int max_filter_insns = 4096;
+
     // Thread body.
     virtual void run();
 
     // Constructor.  i=interface name, d=packet consumer.
     interface(const std::string& i, float delay, packet_consumer& d) :
 	cyberprobe::pcap::interface(*this, i),
-        delayline(d, delay, pcap_datalink(p))
+        delayline(d, delay, pcap_datalink(p)), name(i),
+        filter_changed(false), stats_time(0), kernel_received(0),
+        kernel_dropped(0), interface_dropped(0), cpu(-1)
         {
             thr = 0;
         }
 
+    // Sets the user-specified filter.
+    void add_filter(const std::string& spec) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        user_filter = spec;
+        cyberprobe::pcap::interface::add_filter(spec);
+    }
+
+    virtual void set_target_filter(const std::string& expr) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        target_filter = expr;
+        filter_changed = true;
+    }
+
+    // Runs the capture thread on CPU 'c'.  The delay line buffer is
+    // allocated by the capture thread, so lands in memory local to the
+    // CPU.  Call before start.
+    void set_cpu(int c) { cpu = c; }
+
+    // Joins AF_PACKET fanout group 'group'.  The kernel spreads the
+    // interface's packets across the handles in the group, keeping each
+    // flow on one handle.  Call before start.
+    void join_fanout(uint16_t group);
+
     // Destructor.
     virtual ~interface() {
 	delete thr;
@@ -210,9 +469,59 @@ public:
 			const unsigned char* bytes) {
         delayline::handle(tv, len, bytes);
     }
+
+    virtual void get_stats(probe::stats::interface_stats& s) {
+        delayline::get_stats(s);
+        s.kernel_received = kernel_received;
+        s.kernel_dropped = kernel_dropped;
+        s.interface_dropped = interface_dropped;
+    }
     
 };
 
+// A device made of several capture queues, each a device with its own
+// thread, e.g. handles in an AF_PACKET fanout group.  Queues share
+// nothing, so each feeds delivery without contending with the others.
+class queue_set : public device {
+private:
+
+    std::vector<std::unique_ptr<device> > queues;
+
+public:
+
+    // Adds a queue, which the set then owns.
+    void add(device* d) { queues.emplace_back(d); }
+
+    virtual void start() {
+        for(auto it = queues.begin(); it != queues.end(); it++)
+            (*it)->start();
+    }
+
+    virtual void stop() {
+        for(auto it = queues.begin(); it != queues.end(); it++)
+            (*it)->stop();
+    }
+
+    virtual void join() {
+        for(auto it = queues.begin(); it != queues.end(); it++)
+            (*it)->join();
+    }
+
+    virtual void replay(packet_consumer& c) {
+        for(auto it = queues.begin(); it != queues.end(); it++)
+            (*it)->replay(c);
+    }
+
+    virtual void set_target_filter(const std::string& expr) {
+        for(auto it = queues.begin(); it != queues.end(); it++)
+            (*it)->set_target_filter(expr);
+    }
+
+    // Counters are the sum over the queues.
+    virtual void get_stats(probe::stats::interface_stats& s);
+
+};
+
 };
 
 };
@@ -34,6 +34,11 @@ protected:
     // Convert a specification into a resource.
     virtual resources::resource* create(resources::specification& spec);
 
+    // Target changes in an update are applied to the delivery engine as
+    // one batch.
+    virtual void begin_changes() { deliv.begin_targets(); }
+    virtual void end_changes() { deliv.commit_targets(); }
+
 public:
 
     // Set filter for packet capture.
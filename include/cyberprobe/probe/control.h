@@ -77,19 +77,35 @@ namespace control {
 
 	// Methods which implement the commands.
 	void cmd_endpoints();
-	void cmd_targets();
+	void cmd_targets(const json& j);
 	void cmd_interfaces();
 	void cmd_parameters();
+	void cmd_stats();
 	void cmd_add_interface(const json& j);
 	void cmd_remove_interface(const json& j);
 	void cmd_add_target(const json& j);
 	void cmd_remove_target(const json& j);
+	void cmd_add_targets(const json& j);
+	void cmd_remove_targets(const json& j);
+	void cmd_replace_targets(const json& j);
 	void cmd_add_endpoint(const json& j);
 	void cmd_remove_endpoint(const json& j);
 	void cmd_auth(const json& j);
 	void cmd_add_parameter(const json& j);
 	void cmd_remove_parameter(const json& j);
 
+	// Reads the targets of a bulk target command: a 'targets' array in
+	// the request, or 'count' target objects on the lines following it.
+	// All lines are read before an invalid target is reported.
+	void read_targets(const json& j, std::list<target::spec>& lst);
+
+	// Bulk target command response.
+	void targets_ok(const std::string& msg, size_t count,
+			uint64_t version);
+
+	// Most targets in a bulk command.
+	static const size_t max_bulk_targets = 10000000;
+
 	// OK response.
 	void ok(int status, const std::string& msg);
 
@@ -8,6 +8,8 @@
 #include <cyberprobe/probe/capture.h>
 #include <cyberprobe/probe/packet_consumer.h>
 #include <cyberprobe/util/address_map.h>
+#include <cyberprobe/util/counter.h>
+#include <cyberprobe/util/flow_cache.h>
 #include <cyberprobe/probe/interface.h>
 #include <cyberprobe/probe/endpoint.h>
 #include <cyberprobe/probe/target.h>
@@ -19,6 +21,11 @@
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+#include <unistd.h>
 
 namespace cyberprobe {
 
@@ -67,11 +74,72 @@ public:
 
 };
 
+// Delivery policy for a target.  One policy is shared by every address
+// the target matches, and updated by capture threads without a lock.
+class target_policy {
+public:
+
+    unsigned int sample;           // Deliver 1 packet in N, 0 = all.
+    unsigned int snaplen;          // IP bytes delivered, 0 = all.
+    uint64_t rate;                 // Bytes per second, 0 = no limit.
+    uint64_t burst;                // Token bucket size, bytes.
+
+    target_policy(const target::spec& sp);
+
+    // True if sampling skips the next packet.
+    bool sampled_out() {
+	return sample > 1 &&
+	    seen.fetch_add(1, std::memory_order_relaxed) % sample != 0;
+    }
+
+    // Takes 'len' bytes from the token bucket, for a packet captured at
+    // 'tv'.  False if there aren't enough.
+    bool admit(timeval tv, uint64_t len);
+
+    // True if the policy is the one 'sp' describes.
+    bool same(const target::spec& sp) const;
+
+    // Copies the policy into 'sp'.
+    void get(target::spec& sp) const;
+
+private:
+
+    // Tokens are millionths of a byte, so that a refill after less than
+    // a byte's worth of time isn't lost.
+    static const int64_t scale = 1000000;
+
+    std::atomic<uint64_t> seen;    // Packets offered for sampling.
+    std::atomic<int64_t> tokens;   // Bytes which may be sent, scaled.
+    std::atomic<uint64_t> last;    // Time of last refill, microseconds.
+
+};
+
 // Results of a match, returned by ipv4_match and ipv6_match.
 class match {
 public:
     std::shared_ptr<std::string> device;
     std::shared_ptr<std::string> network;
+    std::shared_ptr<target_policy> policy;   // Null = deliver everything.
+    unsigned int stats_slot;       // Slot in the per-device counters.
+    unsigned int sampled_slot;     // Slots in the policy counters.
+    unsigned int limited_slot;
+    unsigned int truncated_slot;
+    match() : stats_slot(0), sampled_slot(0), limited_slot(0),
+	      truncated_slot(0) {}
+};
+
+// Targets matched by a packet, returned by ipv4_match and ipv6_match.  A
+// packet can match targets by either address, and by more than one
+// prefix.  Each device appears once.
+class match_set {
+public:
+    class hit {
+    public:
+	const match* m;
+	direction dir;             // FROM_TARGET: hit on source address.
+	hit(const match* m, direction dir) : m(m), dir(dir) {}
+    };
+    std::vector<hit> hits;
 };
 
 // Internal ipv4_match and ipv6_match state.
@@ -79,14 +147,18 @@ class match_state {
 
 public:
 
-    match_state(const std::string& d, const std::string& n) :
-        device(d), network(n) {}
+    match_state(const std::string& d, const std::string& n,
+		std::shared_ptr<target_policy> p = 0) :
+        device(d), network(n), policy(p) {}
     match_state() {}
     
     // On a match, these values are the input to 'mangling'.
     std::string device;
     std::string network;
 
+    // Delivery policy, shared by the matches.
+    std::shared_ptr<target_policy> policy;
+
     // Caching hits for templated values - the output of 'mangling'.
     std::map<tcpip::ip4_address, match> mangled;   // IPv4
     std::map<tcpip::ip6_address, match> mangled6;  // IPv6
@@ -108,7 +180,8 @@ public:
 // to device IDs.  IP packets are only delivered if they contain an address
 // which hits in the target map.
 //
-// Note an IP address can only can be mapped to a single device.
+// A packet is delivered once for each device it matches: by source and
+// destination address, and by overlapping prefixes.
 
 class delivery : public parameterised, public management,
                  public packet_consumer {
@@ -124,10 +197,63 @@ private:
     std::mutex senders_mutex;
     std::map<endpoint::spec, sender*> senders;
 
+    // Copy of the senders for the packet path, which reads it without the
+    // senders lock.  Replaced when endpoints change.  Stopped senders are
+    // kept, as a capture thread may still be delivering to one.
+    typedef std::vector<sender*> sender_list;
+    std::atomic<const sender_list*> senders_snapshot;
+
+    // Snapshot epoch, bumped each time the snapshot is replaced.  Starts
+    // at 1, 0 means not reading.
+    std::atomic<uint64_t> snapshot_epoch;
+
+    // A capture thread's reading of the snapshot: the epoch it started
+    // reading in, or 0.  On a cache line of its own.
+    struct reader_slot {
+	std::atomic<uint64_t> epoch;
+	char pad[64 - sizeof(std::atomic<uint64_t>)];
+	reader_slot() : epoch(0) {}
+    };
+
+    std::mutex reader_slots_mutex;
+    std::list<std::unique_ptr<reader_slot> > reader_slots;
+
+    // Returns the calling thread's slot.
+    reader_slot& get_reader_slot();
+
+    // Replaced snapshots, and the epoch they were replaced in.  A copy is
+    // freed once every thread reading started in that epoch or later.
+    // Held for at most one endpoint change after that.
+    std::list<std::pair<uint64_t, std::unique_ptr<const sender_list> > >
+    retired_snapshots;
+
+    // Replaces the senders snapshot.  Caller holds senders_mutex.
+    void update_senders_snapshot();
+
+    // Frees retired snapshots no thread can still be reading.  Caller
+    // holds senders_mutex.
+    void free_snapshots();
+
     // Interfaces
     std::mutex interfaces_mutex;
     std::map<interface::spec, capture::device*> interfaces;
 
+    // Fanout group ID for the next multi-queue interface.
+    uint16_t next_fanout_group;
+
+    // Statistics.  Counters are sharded per thread, and only summed when
+    // read.
+    util::counter packets_in;
+    util::counter bytes_in;
+    util::counter unmatched;
+    util::counter not_ip;
+    util::counter_table target_counts;
+
+    // Packets not delivered, or delivered in part, by target policy.
+    util::counter_table sampled_counts;
+    util::counter_table limited_counts;
+    util::counter_table truncated_counts;
+
     // Parameters and lock
     std::mutex parameters_mutex;
     std::map<std::string, std::string> parameters;
@@ -142,22 +268,134 @@ private:
 		       int linktype,		   /* PCAP linktype */
 		       link_info& link);
 
-    // IPv4 header to device ID
+    // IPv4 header to device IDs.  The match set returned is owned by the
+    // calling thread's flow cache, and valid until its next match.
     bool ipv4_match(const_iterator& start,	   /* Start of packet */
 		    const_iterator& end,           /* End of packet */
-		    const match*& hit,
-		    tcpip::ip4_address& match,
-                    direction& direc,
+		    const match_set*& ms,
 		    const link_info&);
 
-    // IPv6 header to device ID
+    // IPv6 header to device IDs.
     bool ipv6_match(const_iterator& start,	   /* Start of packet */
 		    const_iterator& end,           /* End of packet */
-		    const match*& hit,
-		    tcpip::ip6_address& match,
-                    direction& direc,
+		    const match_set*& ms,
 		    const link_info&);
 
+    // Adds targets matching 'addr' to 'ms'.  Called with targets_mutex
+    // held.
+    template <class A>
+    void match_address(util::address_map<A, match_state>& map,
+		       std::map<A, match> match_state::* mangled,
+		       const A& addr, direction dir,
+		       const link_info& link, match_set& ms);
+
+    // Applies a target's delivery policy to a packet of 'len' bytes,
+    // captured at 'tv'.  Returns false if the packet isn't delivered,
+    // otherwise 'len' is set to the bytes to deliver.
+    bool apply_policy(const match& m, timeval tv, size_t& len);
+
+    // Copies of a packet for delivery, made on first use: one whole, and
+    // one truncated.
+    class packet_copies {
+	const_iterator start, end;
+	packet_ptr whole, cut;
+    public:
+	packet_copies(const_iterator start, const_iterator end) :
+	    start(start), end(end) {}
+	const packet_ptr& get(size_t len) {
+	    if (len >= size_t(end - start)) {
+		if (!whole)
+		    whole.reset(new std::vector<unsigned char>(start, end));
+		return whole;
+	    }
+	    if (!cut || cut->size() != len)
+		cut.reset(new std::vector<unsigned char>(start, start + len));
+	    return cut;
+	}
+    };
+
+    // A set of newly added targets, whose recent history is to be
+    // replayed.
+    class replay_set {
+    public:
+	util::address_map<tcpip::ip4_address, bool> targets;
+	util::address_map<tcpip::ip6_address, bool> targets6;
+	bool empty;
+	replay_set() : empty(true) {}
+	void add(const target::spec& sp);
+    };
+
+    // Delivers a packet replayed from a lookback buffer, if a target in
+    // 'rs' is responsible for it.
+    void replay_packet(timeval tv, const std::vector<unsigned char>& packet,
+		       int datalink, replay_set& rs);
+
+    // Passes lookback packets to replay_packet for new targets.
+    class replay_consumer : public packet_consumer {
+    public:
+	delivery& d;
+	replay_set& rs;
+	replay_consumer(delivery& d, replay_set& rs) : d(d), rs(rs) {}
+	virtual void receive_packet(timeval tv,
+				    const std::vector<unsigned char>& packet,
+				    int datalink) {
+	    d.replay_packet(tv, packet, datalink, rs);
+	}
+    };
+
+    // Replays interface lookback buffers for new targets.
+    void replay_targets(replay_set& rs);
+
+    // Target map changes, called with targets_mutex held.
+    void insert_target(const target::spec& sp);
+    void erase_target(const target::spec& sp);
+
+    // True if the spec's address is a target for the same device.  Called
+    // with targets_mutex held.
+    bool has_target(const target::spec& sp);
+
+    // Gives back a removed target's counter slots.
+    void release_counters(const match& m);
+
+    // Target changes: true = add, false = remove.
+    typedef std::list<std::pair<bool, target::spec> > target_changes;
+
+    // Target changes queued while a batch is open.  The batch lock is
+    // held across any target change, so that changes apply in order.
+    // Bulk changes wait for an open batch to be committed.
+    std::mutex batch_mutex;
+    std::condition_variable batch_done;
+    bool batching;
+    target_changes batch;
+
+    // Target table version, bumped by each change to the target table.
+    // Only changed with targets_mutex held, but read without it to check
+    // flow cache entries.
+    std::atomic<uint64_t> targets_version;
+
+    // Per-thread caches of match results by address pair, valid for one
+    // targets_version.
+    typedef util::flow_cache<4, match_set> flow_cache4;
+    typedef util::flow_cache<16, match_set> flow_cache6;
+
+    // Identifies this delivery's entries in the flow caches.
+    const uint64_t cache_owner;
+
+    // Applies target changes, in order, as one version of the target
+    // table.  Called with batch_mutex held.
+    uint64_t apply_targets(const target_changes& changes);
+
+    // Builds a capture filter expression which matches the target set,
+    // for kernel filtering.  Empty if every packet could match, or the
+    // set is too big.
+    std::string target_filter();
+
+    // Passes the target filter to all interfaces.
+    void update_target_filters();
+
+    // Most target prefixes compiled into a capture filter.
+    static const unsigned int max_filter_targets = 1024;
+
     // Expand device/network template
     static void expand_template(const std::string& in,
 				std::string& out,
@@ -192,10 +430,20 @@ public:
 
     // Constructor: Specify the hostname and port number of the NHIS
     // recipient endpoint.
-    delivery() {}
+    delivery() : senders_snapshot(new sender_list()), snapshot_epoch(1),
+                 batching(false), targets_version(0),
+                 cache_owner(util::new_cache_owner()) {
+
+        // Fanout group IDs are system-wide, so start from the process ID
+        // to stay clear of other processes.
+        next_fanout_group = getpid();
+
+    }
 
     // Destructor.
-    virtual ~delivery() {}
+    virtual ~delivery() {
+        delete senders_snapshot.load();
+    }
 
     // Allows caller to provide an IP packet for delivery.
     virtual void receive_packet(timeval tv,
@@ -203,11 +451,30 @@ public:
 				int datalink);
 
     // Modifies the target map to include a mapping from address to target.
+    // Packets for the target held in interface lookback buffers are
+    // replayed.
     void add_target(const target::spec& sp);
 
     // Removes a target mapping.
     void remove_target(const target::spec& sp);
 
+    // Opens a target batch.  Target additions and removals are queued
+    // until commit_targets, which applies them all under a single lock
+    // with one capture filter update.
+    void begin_targets();
+
+    // Applies the target batch.
+    void commit_targets();
+
+    // Removes then adds target mappings, as a single change to the
+    // target table.
+    virtual uint64_t update_targets(const std::list<target::spec>& add,
+                                    const std::list<target::spec>& remove);
+
+    // Replaces the target table.  Only targets which differ from the
+    // current table are removed or added.
+    virtual uint64_t replace_targets(const std::list<target::spec>& sp);
+
     // Fetch current target list.
     virtual void get_targets(std::list<target::spec>& sp);
 
@@ -241,6 +508,8 @@ public:
         }
     }
 
+    // Get statistics counters.
+    virtual void get_stats(stats::summary& s);
 
 };
 
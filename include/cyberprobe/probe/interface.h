@@ -14,6 +14,7 @@
 #include <nlohmann/json.h>
 
 #include <string>
+#include <vector>
 
 namespace cyberprobe {
 
@@ -41,11 +42,29 @@ namespace interface {
         // Delay
         float delay;
 
+        // Seconds to keep delivered packets for replay to new targets.
+        float lookback;
+
+        // Delay line buffer size in bytes, 0 = default.
+        uint64_t buffer;
+
+        // File backing the delay line buffer, empty = memory.
+        std::string buffer_file;
+
+        // Capture queues, each read by its own thread.  The kernel
+        // spreads packets across the queues by flow.
+        unsigned int queues;
+
+        // CPUs to run capture threads on, queue N on the Nth, wrapping
+        // round.  Empty = no pinning.
+        std::vector<int> cpus;
+
         // Constructors.
-        spec() {}
-        spec(const std::string& ifa) { this->ifa = ifa; delay = 0.0; }
+        spec() : delay(0.0), lookback(0.0), buffer(0), queues(1) {}
+        spec(const std::string& ifa) : ifa(ifa), delay(0.0), lookback(0.0),
+                                       buffer(0), queues(1) {}
 
-        // Hash is <interface>:<filter>:<delay>
+        // Hash is the JSON form
         virtual std::string get_hash() const;
 
         bool operator<(const spec& i) const {
@@ -60,6 +79,26 @@ namespace interface {
 
             if (delay < i.delay)
                 return true;
+            else if (delay > i.delay) return false;
+
+            if (lookback < i.lookback)
+                return true;
+            else if (lookback > i.lookback) return false;
+
+            if (buffer < i.buffer)
+                return true;
+            else if (buffer > i.buffer) return false;
+
+            if (buffer_file < i.buffer_file)
+                return true;
+            else if (buffer_file > i.buffer_file) return false;
+
+            if (queues < i.queues)
+                return true;
+            else if (queues > i.queues) return false;
+
+            if (cpus < i.cpus)
+                return true;
 
             return false;
 
@@ -2,6 +2,8 @@
 #ifndef MANAGEMENT_H
 #define MANAGEMENT_H
 
+#include <stdint.h>
+
 #include <list>
 #include <map>
 
@@ -9,6 +11,7 @@
 #include "endpoint.h"
 #include "target.h"
 #include "parameter.h"
+#include "stats.h"
 
 #include <cyberprobe/network/socket.h>
 
@@ -39,6 +42,16 @@ public:
     virtual void 
     get_targets(std::list<target::spec>& sp) = 0;
 
+    // Removes then adds target mappings, as a single change to the target
+    // table.  Returns the new target table version.
+    virtual uint64_t update_targets(const std::list<target::spec>& add,
+                                    const std::list<target::spec>& remove)
+    = 0;
+
+    // Replaces the whole target table in a single change.  Returns the
+    // new target table version.
+    virtual uint64_t replace_targets(const std::list<target::spec>& sp) = 0;
+
     // Adds an endpoint
     virtual void add_endpoint(const endpoint::spec&) = 0;
 
@@ -58,6 +71,9 @@ public:
     // Get all parameters.
     virtual void get_parameters(std::list<parameter::spec>& lst) = 0;
 
+    // Get statistics counters.
+    virtual void get_stats(stats::summary& s) = 0;
+
 };
 
 }
@@ -0,0 +1,119 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// METRICS EXPORTER RESOURCE
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <thread>
+
+#include <cyberprobe/network/socket.h>
+#include <cyberprobe/resources/specification.h>
+#include <cyberprobe/resources/resource.h>
+#include <cyberprobe/probe/management.h>
+#include <nlohmann/json.h>
+
+namespace cyberprobe {
+
+namespace probe {
+
+namespace metrics {
+
+    using json = nlohmann::json;
+
+    // Metrics exporter specification.
+    class spec : public resources::specification {
+    public:
+
+	// Type is 'metrics'.
+	virtual std::string get_type() const { return "metrics"; }
+
+	// Port to serve on.
+	int port;
+
+	// Constructors.
+	spec() : port(0) {}
+	spec(unsigned short port) : port(port) {}
+
+	// Hash is the port.
+	virtual std::string get_hash() const { 
+	    return std::to_string(port);
+	}
+
+    };
+
+    // Serves probe statistics over HTTP, in Prometheus text format.  Any
+    // request gets the metrics.
+    class exporter : public resources::resource {
+
+    private:
+	
+	// TCP socket, accepting connections.
+	tcpip::tcp_socket svr;
+
+	// Resource specification.
+	spec& sp;
+
+	// Source of the statistics.
+	management& d;
+
+	// True = running, false = closing down.
+	bool running;
+
+	std::thread* thr;
+
+	// Handles a single HTTP request.
+	void serve(tcpip::stream_socket& s);
+
+    public:
+
+	// Thread body.
+	virtual void run();
+
+	// Constructor.
+        exporter(spec& s, management& d) : sp(s), d(d) {
+            running = true;
+	    thr = 0;
+        }
+
+	// Start the thread body.
+	virtual void start() {
+	    std::cerr << "Starting metrics on port " << sp.port << std::endl;
+	    thr = new std::thread(&exporter::run, this);
+	}
+
+	// Stop.
+	virtual void stop() {
+	    running = false;
+	    std::cerr << "Metrics on port " << sp.port << " stopped."
+		      << std::endl;
+	    join();
+	}
+
+	virtual void join() {
+	    if (thr)
+		thr->join();
+	}
+	
+	// Destructor.
+	virtual ~exporter() {
+	    delete thr;
+	}
+
+    };
+
+    void to_json(json& j, const spec& s);
+    
+    void from_json(const json& j, spec& s);
+
+}
+
+}
+
+}
+
+#endif
+
@@ -0,0 +1,139 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// PACKET RING
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+namespace cyberprobe {
+
+namespace capture {
+
+// A fixed-size ring of packets, stored back to back in a single mapping.
+// Records are added at the tail and taken from the head.  In between,
+// records are split into those which have been delivered (the lookback
+// part, oldest first) and those still waiting to be delivered.
+//
+//   head ... delivered ... exit ... waiting ... tail
+//
+// The mapping is anonymous memory, using huge pages when available, or a
+// shared mapping of a file.
+class packet_ring {
+public:
+
+    // Record header, followed by packet data padded to 'alignment'.
+    struct record {
+	struct timeval tv;          // Capture time.
+	struct timeval exit_time;   // Time to deliver.
+	uint32_t len;               // Packet length.
+	uint32_t reserved;
+	const unsigned char* data() const {
+	    return reinterpret_cast<const unsigned char*>(this + 1);
+	}
+    };
+
+private:
+
+    static const size_t alignment = 8;
+
+    // Marks the remainder of the buffer as unused, the next record is at
+    // the start.
+    static const uint32_t wrap = 0xffffffff;
+
+    unsigned char* buffer;
+    size_t size;
+
+    // File descriptor for a file-backed ring, or -1.
+    int fd;
+
+    // Offsets of the oldest record, next record to deliver, and the next
+    // free byte.  'head' and 'exit_pos' always point at a record, when
+    // there is one.
+    size_t head;
+    size_t exit_pos;
+    size_t tail;
+
+    // Records in the ring, and those not yet delivered.
+    size_t count;
+    size_t waiting;
+
+    static size_t record_size(uint32_t len) {
+	return (sizeof(record) + len + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Offset of the record at or after 'pos', following a wrap.
+    size_t locate(size_t pos) const {
+	if (size - pos < sizeof(record)) return 0;
+	if (at(pos)->len == wrap) return 0;
+	return pos;
+    }
+
+    record* at(size_t pos) const {
+	return reinterpret_cast<record*>(buffer + pos);
+    }
+
+public:
+
+    // Creates a ring of 'size' bytes.  If 'file' is non-empty, the ring
+    // is a shared mapping of that file, otherwise it's anonymous memory.
+    packet_ring(size_t size, const std::string& file = "");
+
+    ~packet_ring();
+
+    size_t get_size() const { return size; }
+
+    bool empty() const { return count == 0; }
+
+    // Records waiting for delivery.
+    size_t get_waiting() const { return waiting; }
+
+    // Records delivered but still held.
+    size_t get_delivered() const { return count - waiting; }
+
+    // Returns true if a packet of 'len' bytes can ever be held.
+    bool fits(uint32_t len) const { return record_size(len) <= size; }
+
+    // Adds a packet at the tail.  Returns false if there is not enough
+    // space, in which case the caller should make some.
+    bool push(const struct timeval& tv, const struct timeval& exit_time,
+	      const unsigned char* data, uint32_t len);
+
+    // The oldest record, which may or may not have been delivered.
+    const record& oldest() const { return *at(head); }
+
+    // Discards the oldest record.  It must have been delivered.
+    void pop();
+
+    // The next record to deliver.  Only valid if get_waiting() != 0.
+    const record& next_exit() const { return *at(exit_pos); }
+
+    // Marks the next record to deliver as delivered.
+    void delivered();
+
+    // Calls 'f' with each delivered record, oldest first.
+    template<class F>
+    void for_each_delivered(F f) const {
+	size_t pos = head;
+	for(size_t i = 0; i < count - waiting; i++) {
+	    f(*at(pos));
+	    pos = locate(pos + record_size(at(pos)->len));
+	}
+    }
+
+};
+
+};
+
+};
+
+#endif
+
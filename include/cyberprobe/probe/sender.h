@@ -12,6 +12,7 @@
 #include <cyberprobe/probe/management.h>
 #include <cyberprobe/probe/parameterised.h>
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -23,6 +24,10 @@ using direction = cyberprobe::protocol::direction;
 // Shared pointers to TCP/IP address.
 typedef std::shared_ptr<tcpip::address> address_ptr;
 
+// Shared pointer to an IP packet.  A packet delivered for several targets,
+// or to several endpoints, is only copied once.
+typedef std::shared_ptr<const std::vector<unsigned char> > packet_ptr;
+
 // A packet on the packet queue: Device plus PDU.
 class qpdu {
 public:
@@ -30,7 +35,7 @@ public:
     timeval tv;                             // Valid for: PDU
     std::shared_ptr<std::string> device;    // Valid for: PDU, TARGET_UP/DOWN
     std::shared_ptr<std::string> network; // Valid for: PDU, TARGET_UP/DOWN
-    std::vector<unsigned char> pdu;         // Valid for: PDU
+    packet_ptr pdu;                         // Valid for: PDU
     address_ptr addr;                       // Valid for: TARGET_UP
     direction dir;                // Valid for: PDU, from/to target.
 };
@@ -49,6 +54,13 @@ protected:
     static const unsigned int max_packets = 1024;
     std::queue<qpdu_ptr> packets;
 
+    // Packets and bytes queued, protected by the queue lock.
+    uint64_t queued_packets;
+    uint64_t queued_bytes;
+
+    // Connection failures.
+    std::atomic<uint64_t> reconnects;
+
     // State: true if we're running, false if we've been asked to stop.
     bool running;
 
@@ -59,7 +71,8 @@ protected:
 public:
 
     // Constructor.
-    sender(parameterised& p) : global_pars(p) {
+    sender(parameterised& p) :
+        queued_packets(0), queued_bytes(0), reconnects(0), global_pars(p) {
 	running = true;
 	thr = 0;
     }
@@ -92,8 +105,10 @@ public:
                  std::shared_ptr<std::string> device,
 		 std::shared_ptr<std::string> n,
                  direction dir,
-		 const_iterator& start,
-		 const_iterator& end);
+		 const packet_ptr& pdu);
+
+    // Reads the sender's counters.
+    void get_stats(probe::stats::endpoint_stats& s);
 
     // Called to stop the thread.
     virtual void stop() {
@@ -196,6 +211,13 @@ private:
     // to introduce this device / LIID.
     std::map<std::string, bool> setup;
 
+    // The last packet's encoded Payload.  A packet delivered for several
+    // devices arrives as consecutive PDUs, the Payload is only encoded for
+    // the first.
+    packet_ptr last_packet;
+    direction last_dir;
+    std::vector<unsigned char> last_payload;
+
     // Initialise some configuration
     void initialise() { }
 
@@ -206,7 +228,8 @@ public:
                    const std::string& transp,
 		   const std::map<std::string, std::string>& params,
 		   parameterised& globals) :
-        sender(globals), h(h), p(p), params(params), cur_connect(0)
+        sender(globals), h(h), p(p), params(params), cur_connect(0),
+        last_dir(direction::NOT_KNOWN)
         {
 
             // Get value of etsi-streams parameter, default is 12.
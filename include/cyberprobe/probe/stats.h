@@ -0,0 +1,98 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// STATISTICS
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#include <list>
+#include <string>
+
+#include <nlohmann/json.h>
+
+namespace cyberprobe {
+
+namespace probe {
+
+namespace stats {
+
+    using json = nlohmann::json;
+
+    // Counters for a capture interface.
+    class interface_stats {
+    public:
+        std::string name;
+        uint64_t packets;             // Packets captured.
+        uint64_t bytes;               // Bytes captured.
+        uint64_t kernel_received;     // Received by the kernel filter.
+        uint64_t kernel_dropped;      // Dropped, no room in kernel buffer.
+        uint64_t interface_dropped;   // Dropped by the interface or driver.
+        uint64_t early;               // Sent before delay, ring was full.
+        interface_stats() : packets(0), bytes(0), kernel_received(0),
+                            kernel_dropped(0), interface_dropped(0),
+                            early(0) {}
+    };
+
+    // Counters for a target, by device ID (LIID).
+    class target_stats {
+    public:
+        std::string device;
+        uint64_t packets;             // Packets matched.
+        uint64_t bytes;               // IP bytes matched.
+        uint64_t sampled_out;         // Not delivered, by sampling.
+        uint64_t rate_limited;        // Not delivered, over rate limit.
+        uint64_t truncated;           // Delivered cut to snaplen.
+        uint64_t truncated_bytes;     // Bytes cut off.
+        target_stats() : packets(0), bytes(0), sampled_out(0),
+                         rate_limited(0), truncated(0),
+                         truncated_bytes(0) {}
+    };
+
+    // Counters for a delivery endpoint.
+    class endpoint_stats {
+    public:
+        std::string hostname;
+        unsigned int port;
+        std::string type;
+        uint64_t packets;             // Packets queued for delivery.
+        uint64_t bytes;               // IP bytes queued for delivery.
+        uint64_t queue;               // Current queue depth.
+        uint64_t reconnects;          // Connection failures.
+        endpoint_stats() : port(0), packets(0), bytes(0), queue(0),
+                           reconnects(0) {}
+    };
+
+    // Counters for the whole probe.
+    class summary {
+    public:
+        uint64_t packets;             // Packets into the delivery engine.
+        uint64_t bytes;
+        uint64_t unmatched;           // IP packets matching no target.
+        uint64_t not_ip;              // Packets which weren't IP.
+        std::list<interface_stats> interfaces;
+        std::list<target_stats> targets;
+        std::list<endpoint_stats> endpoints;
+        summary() : packets(0), bytes(0), unmatched(0), not_ip(0) {}
+    };
+
+    void to_json(json& j, const interface_stats& s);
+    void to_json(json& j, const target_stats& s);
+    void to_json(json& j, const endpoint_stats& s);
+    void to_json(json& j, const summary& s);
+
+    // Formats counters in the Prometheus text exposition format.
+    void to_prometheus(const summary& s, std::string& out);
+
+}
+
+}
+
+}
+
+#endif
+
@@ -45,8 +45,26 @@ namespace target {
 
         enum { IPv4, IPv6} universe;
 
+        // Delivery policy.  Deliver 1 packet in 'sample', 0 = all.
+        unsigned int sample;
+
+        // IP bytes of each packet delivered, 0 = all.
+        unsigned int snaplen;
+
+        // Delivery rate limit in bytes per second, 0 = none, and the
+        // bytes which can be sent in a burst, 0 = one second's worth.
+        uint64_t rate;
+        uint64_t burst;
+
         // Constructors.
-        spec() { universe = IPv4; }
+        spec() : sample(0), snaplen(0), rate(0), burst(0) {
+            universe = IPv4;
+        }
+
+        // True if a delivery policy applies.
+        bool has_policy() const {
+            return sample > 1 || snaplen != 0 || rate != 0;
+        }
 
         // Set IPv4 address match.
         void set_ipv4(const std::string& device, const std::string& network,
@@ -68,22 +86,37 @@ namespace target {
             this->mask = mask;
         }
 
-        // Hash is form ipaddr:device.
+        // Hash is a compact binary key: universe, mask and address bytes,
+        // then network and device separated by a null, then any delivery
+        // policy.  Config files may hold a great many targets, so this
+        // avoids string formatting.
         virtual std::string get_hash() const { 
-            std::ostringstream buf;
-	
-            if (universe == IPv4)
-                buf << "IPv4:" << addr;
-            else
-                buf << "IPv6:" << addr6;
-
-            buf << ":" << network;
-
-            buf << ":" << device;
-
-            buf << ":" << mask;
-
-            return buf.str();
+            const std::vector<unsigned char>& a =
+                (universe == IPv4) ? addr.addr : addr6.addr;
+
+            std::string buf;
+            buf.reserve(2 + a.size() + network.size() + 1 + device.size());
+
+            buf.push_back(universe == IPv4 ? '4' : '6');
+            buf.push_back(static_cast<char>(mask));
+            buf.append(a.begin(), a.end());
+            buf.append(network);
+            buf.push_back('\0');
+            buf.append(device);
+
+            if (has_policy()) {
+                buf.push_back('\0');
+                buf.append(reinterpret_cast<const char*>(&sample),
+                           sizeof(sample));
+                buf.append(reinterpret_cast<const char*>(&snaplen),
+                           sizeof(snaplen));
+                buf.append(reinterpret_cast<const char*>(&rate),
+                           sizeof(rate));
+                buf.append(reinterpret_cast<const char*>(&burst),
+                           sizeof(burst));
+            }
+
+            return buf;
         }
 
     };
@@ -20,6 +20,54 @@ namespace protocol {
     // Forward declarations.
     class base_context;
 
+    // Context kinds, one for each context class.
+    enum context_kind {
+	ROOT_CONTEXT,
+	IP4_CONTEXT,
+	IP6_CONTEXT,
+	TCP_CONTEXT,
+	UDP_CONTEXT,
+	ICMP_CONTEXT,
+	HTTP_REQUEST_CONTEXT,
+	HTTP_RESPONSE_CONTEXT,
+	SMTP_CLIENT_CONTEXT,
+	SMTP_SERVER_CONTEXT,
+	SMTP_AUTH_CONTEXT,
+	FTP_CLIENT_CONTEXT,
+	FTP_SERVER_CONTEXT,
+	DNS_CONTEXT,
+	NTP_CONTEXT,
+	SIP_CONTEXT,
+	RTP_CONTEXT,
+	IMAP_CONTEXT,
+	IMAP_SSL_CONTEXT,
+	POP3_CONTEXT,
+	POP3_SSL_CONTEXT,
+	TLS_CONTEXT,
+	GRE_CONTEXT,
+	ESP_CONTEXT,
+	WLAN_CONTEXT,
+	UNRECOGNISED_STREAM_CONTEXT,
+	UNRECOGNISED_DATAGRAM_CONTEXT
+    };
+
+    // Context type names, indexed by context_kind.  These are the names
+    // events and scripts see.
+    constexpr const char* context_kind_names[] = {
+	"root", "ip4", "ip6", "tcp", "udp", "icmp",
+	"http_request", "http_response",
+	"smtp_client", "smtp_server", "smtp_auth",
+	"ftp_client", "ftp_server",
+	"dns", "ntp", "sip", "rtp",
+	"imap", "imap_ssl", "pop3", "pop3_ssl",
+	"tls", "gre", "esp", "802.11",
+	"unrecognised_stream", "unrecognised_datagram"
+    };
+
+    static_assert(sizeof(context_kind_names) / sizeof(const char*) ==
+		  UNRECOGNISED_DATAGRAM_CONTEXT + 1,
+		  "A context kind is missing a name");
+
     // Shared pointer types.
     typedef std::shared_ptr<base_context> context_ptr;
 
@@ -37,6 +85,9 @@ namespace protocol {
 
     public:
 
+	// Context class, fixed at construction.
+	const context_kind kind;
+
 	// Time of creation.
 	struct timeval creation;
 
@@ -83,20 +134,44 @@ namespace protocol {
 	// Child contexts.
 	std::map<flow_address,context_ptr> children;
 
+	// Ancestors which events look up: the root context, and the
+	// outermost IP context.  Set when the context is added to its
+	// parent, so that finding them doesn't walk the stack.  Empty if
+	// there is no such ancestor, or for the context itself.
+	std::weak_ptr<base_context> root_ancestor;
+	std::weak_ptr<base_context> network_ancestor;
+
 	// Constructor.
-        base_context() { 
+        base_context(context_kind k) : kind(k) { 
 	    id = next_context_id++; 
 	    total_contexts++;
 	    // parent is initialised to 'null'.
 	}
 
 	// Constructor, initialises parent pointer.
-        base_context(context_ptr parent) {
+        base_context(context_kind k, context_ptr parent) : kind(k) {
 	    id = next_context_id++; 
 	    this->parent = parent;
 	    total_contexts++;
 	}
 
+	// Sets the cached ancestors for a new child of 'p'.
+	void link_ancestors(const context_ptr& p) {
+	    if (p->kind == ROOT_CONTEXT)
+		root_ancestor = p;
+	    else
+		root_ancestor = p->root_ancestor;
+	    context_ptr net = p->network_ancestor.lock();
+	    if (!net && p->is_network())
+		net = p;
+	    network_ancestor = net;
+	}
+
+	// True if this is an IP context.
+	bool is_network() const {
+	    return kind == IP4_CONTEXT || kind == IP6_CONTEXT;
+	}
+
 	// Given a flow address, returns the child context.
 	context_ptr get_child(const flow_address& f) {
 	    std::lock_guard<std::mutex> lock(mutex);
@@ -122,8 +197,13 @@ namespace protocol {
 	// Returns constructor ID.
 	context_id get_id() { return id; }
 
-	// Returns a context 'type'.
-	virtual std::string get_type() = 0;
+	// Returns a context 'type' name.
+	std::string get_type() const { return context_kind_names[kind]; }
+
+	// Returns this context as its class.  T must be the class for
+	// 'kind'; check that first.
+	template <class T>
+	T& as() { return static_cast<T&>(*this); }
 
 	// Delete myself.
 	void delete_myself() {
@@ -41,12 +41,13 @@ namespace protocol {
 	static const int default_ttl = 120;
 
 	// Constructor.
-        context(manager& m) : reapable(m), mgr(m) { 
+        context(manager& m, context_kind k) :
+            base_context(k), reapable(m), mgr(m) { 
 	}
 
 	// Constructor, initialises parent pointer.
-        context(manager& m, context_ptr parent) : 
-            base_context(parent), reapable(m), mgr(m) { 
+        context(manager& m, context_kind k, context_ptr parent) : 
+            base_context(k, parent), reapable(m), mgr(m) { 
 	}
 
 #ifdef BROKEN
@@ -110,14 +111,28 @@ namespace protocol {
 	virtual ~context() { 
 	}
 
-	// Delete myself.
-	void reap() {
+	// Delete myself.  False if the parent is busy, see reapable.
+	bool reap() {
 
 	    // Erase myself from my parent's child map.
 	    // Should call my destructor, I guess.
 	    context_ptr p = parent.lock();
-	    if (p)
-		p->children.erase(addr);
+	    if (!p) return true;
+
+	    // Take the child out under the parent's lock, but let it go
+	    // after, its destruction may take other locks.
+	    context_ptr me;
+	    {
+		std::unique_lock<std::mutex> lock(p->mutex, std::try_to_lock);
+		if (!lock.owns_lock()) return false;
+		auto it = p->children.find(addr);
+		if (it == p->children.end() || it->second.get() != this)
+		    return true;
+		me.swap(it->second);
+		p->children.erase(it);
+	    }
+
+	    return true;
 
 	}
 
@@ -140,6 +155,7 @@ namespace protocol {
 	    else {
 
 		ch = (*create_fn)(mc->mgr, f, mc);
+		ch->link_ancestors(parent);
 		parent->children[f] = ch;
 
 		// Set creation time.
@@ -177,7 +193,7 @@ namespace protocol {
 		    // Only do this on a root context, otherwise we'll just
 		    // find the same context in many cases.
 
-		    if ((parent->get_type() == "root") && 
+		    if ((parent->kind == ROOT_CONTEXT) && 
 			(parent->children.find(f_rev) != parent->children.end())) {
 
 			// If the parent's reverse has such a child, use that
@@ -220,7 +236,7 @@ namespace protocol {
     public:
 
         root_context(manager& m) : 
-            context(m) {
+            context(m, ROOT_CONTEXT) {
 	    addr.src.layer = ROOT;
 	    addr.dest.layer = ROOT;
 	}
@@ -255,7 +271,6 @@ namespace protocol {
 	    network = n;
 	}
 
-	virtual std::string get_type() { return "root"; }
     };
 
 }
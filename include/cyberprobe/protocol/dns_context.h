@@ -27,19 +27,16 @@ namespace protocol {
     public:
     
         // Constructor.
-        dns_context(manager& m) : context(m) {}
+        dns_context(manager& m) : context(m, DNS_CONTEXT) {}
 
         // Constructor, describing flow address and parent pointer.
         dns_context(manager& m, const flow_address& a, context_ptr p)
-            :  context(m)
+            :  context(m, DNS_CONTEXT)
             {
                 addr = a;
                 parent = p; 
             }
 
-        // Type is "dns".
-        virtual std::string get_type() { return "dns"; }
-
         typedef std::shared_ptr<dns_context> ptr;
 
         static context_ptr create(manager& m, const flow_address& f, 
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <list>
+#include <vector>
 
 #include <cyberprobe/protocol/pdu.h>
 #include <cyberprobe/protocol/address.h>
@@ -93,30 +94,110 @@ namespace protocol {
 
     };
 
+    // DNS message sections.
+    enum dns_section_t {
+	DNS_QUERIES = 0,
+	DNS_ANSWERS = 1,
+	DNS_AUTHORITIES = 2,
+	DNS_ADDITIONAL = 3
+    };
+
+    // A name in a DNS message, held as the offset of its first label.
+    // Compression pointers are only followed when the name is decoded.
+    class dns_name {
+    public:
+	uint16_t offset;
+
+	// Length of the decoded name.
+	uint16_t length;
+    };
+
+    // A query or resource record in a DNS message.  Rdata is an offset
+    // and length in the message.  Queries have no TTL or rdata.
+    class dns_record {
+    public:
+	dns_name name;
+	uint16_t type;
+	uint16_t cls;
+	uint32_t ttl;
+	uint16_t rdoffset;
+	uint16_t rdlength;
+
+	// Name in the rdata of CNAME, PTR, NS and MX records.
+	bool has_rdname;
+	dns_name rdname;
+    };
+
+    // A decoded DNS message.  The records are held in one array, queries,
+    // answers, authorities and additional records in turn, and refer to
+    // the copy of the message in 'data'.
+    class dns_packet {
+    public:
+	pdu data;
+	dns_header hdr;
+	std::vector<dns_record> records;
+
+	// Start of each section in 'records', and the end.
+	uint32_t sections[5];
+
+	size_t count(int section) const {
+	    if (section < DNS_QUERIES || section > DNS_ADDITIONAL) return 0;
+	    return sections[section + 1] - sections[section];
+	}
+
+	const dns_record& record(int section, size_t i) const {
+	    return records[sections[section] + i];
+	}
+
+	pdu_iter rdata(const dns_record& r) const {
+	    return data.begin() + r.rdoffset;
+	}
+
+	// Decodes a name, following compression pointers.
+	void decode(const dns_name& n, std::string& name) const;
+
+	// Address in the rdata of an A or AAAA record, as a string.
+	// Returns false for other records.
+	bool rdaddress(const dns_record& r, std::string& addr) const;
+
+	// The records in the list form used by forgery and Lua.
+	void to_query(const dns_record& r, dns_query& q) const;
+	void to_rr(const dns_record& r, dns_rr& rr) const;
+    };
+
+    // Per-thread space the decoder writes records into.  It's kept
+    // between messages, so decoding doesn't allocate once it has grown.
+    class dns_arena {
+    public:
+	std::vector<dns_record> records;
+	static dns_arena& local();
+    };
+
     class dns_decoder {
 	pdu_iter s;
 	pdu_iter e;
 	pdu_iter ptr;
+	dns_arena& arena;
 
     public:
 
 	dns_header hdr;
-	std::list<dns_query> queries;
-	std::list<dns_rr> answers;
-	std::list<dns_rr> authorities;
-	std::list<dns_rr> additional;
 
-	dns_decoder(pdu_iter s, pdu_iter e) {
-	    this->s = s; this->e = e;
-	}
+	// Start of each section in the arena's records, and the end.
+	uint32_t sections[5];
+
+	dns_decoder(pdu_iter s, pdu_iter e);
 	void parse();
 	void parse_header(pdu_iter header);
-	void parse_name(pdu_iter ms, pdu_iter me, 
-			pdu_iter& pos, pdu_iter e, std::string&,
-			bool& first);
-	void parse_queries();
-	void parse_rrs(std::list<dns_rr>& rrs, int n);
-	void parse_rr(dns_rr& r);
+
+	// Checks the name at 'pos' and steps over it.  'end' bounds the
+	// labels at 'pos', pointers may go anywhere in the message.
+	dns_name parse_name(pdu_iter& pos, pdu_iter end);
+
+	void parse_records(int n, bool query);
+
+	// Copies the message and its records out of the arena.
+	void get(dns_packet& p) const;
 
     private:
 
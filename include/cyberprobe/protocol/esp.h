@@ -17,8 +17,6 @@ namespace protocol {
                     const flow_address& fAddr,
                     context_ptr ctxPtr);
 
-	virtual std::string get_type();
-
 	typedef std::shared_ptr<esp_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
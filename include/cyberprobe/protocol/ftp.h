@@ -95,19 +95,16 @@ namespace protocol {
 	
 	// Constructor.
         ftp_client_context(manager& m) : 
-            context(m) {
+            context(m, FTP_CLIENT_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         ftp_client_context(manager& m, const flow_address& a, 
                            context_ptr p) : 
-            context(m) { 
+            context(m, FTP_CLIENT_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type.
-	virtual std::string get_type() { return "ftp_client"; }
-
 	typedef std::shared_ptr<ftp_client_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
@@ -132,19 +129,16 @@ namespace protocol {
 	
 	// Constructor.
         ftp_server_context(manager& m) : 
-            context(m) {
+            context(m, FTP_SERVER_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         ftp_server_context(manager& m, const flow_address& a, 
                            context_ptr p) : 
-            context(m) { 
+            context(m, FTP_SERVER_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type.
-	virtual std::string get_type() { return "ftp_server"; }
-
 	typedef std::shared_ptr<ftp_server_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
@@ -172,7 +166,8 @@ namespace protocol {
         // FTP request processing function.
 	static void process(manager&, context_ptr c, const pdu_slice& s);
 
-    private:
+        // The client / server functions are used directly when the stream
+        // is identified by content rather than port number.
 
         // FTP client request processing function.
         static void process_client(manager&, context_ptr c,
@@ -71,14 +71,89 @@ namespace protocol {
 
 	void reset_transaction() {
 	    protocol = method = url = code = status = "";
-	    body.clear();
 	    header.clear();
+	    body_url.clear();
+	    pending.clear();
+	    chunk_position = 0;
+
+	    // Don't hang on to a large body allocation between transactions.
+	    if (body.capacity() > retained_body_capacity)
+		pdu().swap(body);
+	    else
+		body.clear();
+	}
+
+	// Finishes the current transaction, raising the event and readying
+	// the parser for the next one.
+	void complete_transaction(context_ptr c, const pdu_time& t,
+				  manager& mgr);
+
+	// Appends body data, up to the body capture limit.  Data beyond the
+	// limit is skipped.
+	void capture_body(pdu_iter s, pdu_iter e) {
+	    if (body_limit != 0 && body.size() >= body_limit) return;
+	    if (body_limit != 0 &&
+		(unsigned long long) (e - s) > body_limit - body.size())
+		e = s + (body_limit - body.size());
+	    body.insert(body.end(), s, e);
+	}
+
+	// Body chunk delivery, see body_chunk_size.  Data not yet making up
+	// a whole chunk is held in 'pending'.  'chunk_position' is the body
+	// position of the next chunk.
+	std::string body_url;
+	pdu pending;
+	unsigned long long chunk_position;
+
+	// Works out the URL the body belongs to, when the header is
+	// complete.
+	void start_body(context_ptr c);
+
+	// Passes body data to the capture and to chunk delivery.
+	void body_data(context_ptr c, pdu_iter s, pdu_iter e,
+		       const pdu_time& t, manager& mgr) {
+	    capture_body(s, e);
+	    if (body_chunk_size != 0)
+		stream_body(c, s, e, t, mgr);
 	}
 
+	// Delivers body data in chunks.
+	void stream_body(context_ptr c, pdu_iter s, pdu_iter e,
+			 const pdu_time& t, manager& mgr);
+
+	// Raises an http_body event for s..e.
+	void raise_chunk(context_ptr c, pdu_iter s, pdu_iter e, bool final,
+			 const pdu_time& t, manager& mgr);
+
+	// Request URL, normalised against the host header.
+	std::string request_url();
+
+	// Body allocations larger than this are released when a transaction
+	// completes.
+	static const unsigned long retained_body_capacity = 65536;
+
+	// Maximum length of a request line, status line or header field.
+	// Anything longer is treated as a protocol violation.
+	static const unsigned long max_field_length = 65536;
+
     public:
 
+	// Default body capture limit (bytes) for new HTTP flows.  Zero means
+	// no limit.
+	static unsigned long long default_body_limit;
+
+	// Body capture limit (bytes) for this flow.  Body data beyond the
+	// limit is skipped over, not buffered.  Zero means no limit.
+	unsigned long long body_limit;
+
+	// When not zero, body data is also delivered in http_body events
+	// of up to this many bytes as it arrives, ending with one marked
+	// final.  These are not subject to the body capture limit.
+	static unsigned long body_chunk_size;
+
 	http_parser(variant_t var) {
 	    variant = var;
+	    body_limit = default_body_limit;
 	    reset_transaction();
 
 	    if (var == REQUEST)
@@ -148,15 +223,15 @@ namespace protocol {
 
 	// Constructor.
         http_request_context(manager& m) :
-            context(m), http_parser(REQUEST), streaming_requested(false),
-            streaming(false) {
+            context(m, HTTP_REQUEST_CONTEXT), http_parser(REQUEST),
+            streaming_requested(false), streaming(false) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         http_request_context(manager& m, const flow_address& a,
 			     context_ptr p) :
-            context(m), http_parser(REQUEST), streaming_requested(false),
-            streaming(false) {
+            context(m, HTTP_REQUEST_CONTEXT), http_parser(REQUEST),
+            streaming_requested(false), streaming(false) {
 	    addr = a; parent = p;
 	}
 
@@ -165,9 +240,6 @@ namespace protocol {
         bool streaming_requested;
         bool streaming;
 
-	// Type.
-	virtual std::string get_type() { return "http_request"; }
-
 	typedef std::shared_ptr<http_request_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
@@ -192,19 +264,18 @@ namespace protocol {
 
 	// Constructor.
         http_response_context(manager& m) :
-            context(m), http_parser(RESPONSE), streaming(false) {
+            context(m, HTTP_RESPONSE_CONTEXT), http_parser(RESPONSE),
+            streaming(false) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         http_response_context(manager& m, const flow_address& a,
 			      context_ptr p) :
-            context(m), http_parser(RESPONSE), streaming(false) {
+            context(m, HTTP_RESPONSE_CONTEXT), http_parser(RESPONSE),
+            streaming(false) {
 	    addr = a; parent = p;
 	}
 
-	// Type.
-	virtual std::string get_type() { return "http_response"; }
-
 	typedef std::shared_ptr<http_response_context> ptr;
 
         bool streaming;
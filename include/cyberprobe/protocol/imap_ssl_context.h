@@ -20,22 +20,16 @@ namespace protocol {
     public:
 
         // Constructor.
-        imap_ssl_context(manager& m) : context(m) {}
+        imap_ssl_context(manager& m) : context(m, IMAP_SSL_CONTEXT) {}
 
         // Constructor, when specifying flow address and parent context.
         imap_ssl_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m)
+            : context(m, IMAP_SSL_CONTEXT)
             { 
                 addr = a;
                 parent = p; 
             }
 
-        // Type is "imap_ssl".
-        virtual std::string get_type()
-            {
-                return "imap_ssl";
-            }
-
         typedef std::shared_ptr<imap_ssl_context> ptr;
 
         static context_ptr create(manager& m, const flow_address& f, context_ptr par)
@@ -0,0 +1,169 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// IP fragment reassembly
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CYBERMON_IP_DEFRAG_H
+#define CYBERMON_IP_DEFRAG_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <cyberprobe/protocol/base_context.h>
+#include <cyberprobe/protocol/pdu.h>
+
+namespace cyberprobe {
+namespace protocol {
+
+    // Fragment reassembly, shared by IPv4 and IPv6.  Each datagram under
+    // reassembly is built in a single contiguous buffer, with a list of
+    // the byte ranges received so far.  Datagrams time out a fixed period
+    // after their first fragment, measured in packet time, and the total
+    // buffer memory held is capped, the oldest datagrams being discarded
+    // to make room.
+    class ip_defrag {
+
+    public:
+
+	// How overlapping fragment data is resolved.
+	typedef enum {
+	    FIRST_WINS,            // Keep the data which arrived first.
+	    LAST_WINS              // Overwrite with the latest data.
+	} overlap_policy;
+
+	// Memory limit on reassembly buffers across all datagrams, in
+	// bytes.  0 = no limit.
+	static unsigned long long memory_limit;
+
+	// Seconds a datagram may remain incomplete.
+	static unsigned long timeout;
+
+	// Overlap policy.
+	static overlap_policy policy;
+
+	// Reassembly counters.
+	class counters {
+	public:
+	    uint64_t fragments;    // Fragments received.
+	    uint64_t reassembled;  // Datagrams completed.
+	    uint64_t timed_out;    // Datagrams discarded on timeout.
+	    uint64_t evicted;      // Datagrams discarded on memory limit.
+	    uint64_t overlaps;     // Fragments overlapping earlier data.
+	    uint64_t invalid;      // Fragments inconsistent with datagram.
+	    uint64_t held;         // Datagrams under reassembly now.
+	    uint64_t held_bytes;   // Buffer memory they hold.
+	    counters() : fragments(0), reassembled(0), timed_out(0),
+			 evicted(0), overlaps(0), invalid(0), held(0),
+			 held_bytes(0) {}
+	};
+
+	// Returns a snapshot of the counters.
+	static counters get_counters();
+
+	// Discards datagrams which have timed out at 'now', so that they
+	// don't wait for the next fragment.  Called for every packet, and
+	// from a timer when the link is quiet; only does anything once per
+	// second of 'now', and never waits for the lock.
+	static void tick(const pdu_time& now);
+
+	// Space reserved at the front of the reassembly buffer, so that the
+	// header can be put in front of the payload without a copy.
+	static const unsigned long headroom = 60;
+
+	// Largest datagram payload accepted.
+	static const unsigned long max_payload = 65535;
+
+	// Constructs a key identifying a datagram: the context the packet
+	// arrived on, the addresses, IP ID and protocol.
+	static std::string make_key(context_id ctxt,
+				    pdu_iter src, pdu_iter dest,
+				    unsigned int addr_len,
+				    uint32_t id, uint8_t proto);
+
+	// Adds a fragment.  'hs'..'he' is the header to use for the
+	// reassembled datagram, taken from the fragment at offset 0.  's'..'e'
+	// is the fragment payload, which belongs at 'offset' in the datagram,
+	// and 'more' is set on all but the last fragment.  Returns true when
+	// the datagram is complete: 'out' is then the reassembly buffer, with
+	// the header at 'start' immediately followed by the payload.  The
+	// caller is responsible for fixing up header fields.
+	static bool add(const std::string& key, const pdu_time& time,
+			pdu_iter hs, pdu_iter he,
+			unsigned long offset, bool more,
+			pdu_iter s, pdu_iter e,
+			pdu& out, unsigned long& start);
+
+    private:
+
+	// A datagram under reassembly.
+	class datagram {
+	public:
+
+	    // Reassembly buffer, 'headroom' bytes then the payload.
+	    pdu buffer;
+
+	    // Header from the first fragment.
+	    pdu header;
+
+	    // Payload ranges received, first -> last (exclusive).  Adjacent
+	    // ranges are merged, so a complete payload is one range.
+	    std::map<unsigned long, unsigned long> ranges;
+
+	    // Payload length, known once the last fragment has arrived.
+	    bool total_known;
+	    unsigned long total;
+
+	    // Packet time after which the datagram is discarded.
+	    pdu_time expiry;
+
+	    // Position in the age list.
+	    std::list<std::string>::iterator age_pos;
+
+	    datagram() : total_known(false), total(0) {}
+
+	};
+
+	typedef std::map<std::string, datagram> datagram_map;
+
+	static std::mutex mutex;
+
+	// Datagrams under reassembly.
+	static datagram_map datagrams;
+
+	// Datagram keys, oldest first.
+	static std::list<std::string> age;
+
+	// Buffer memory in use.
+	static unsigned long long used;
+
+	static counters stats;
+
+	// Second of the last tick.
+	static std::atomic<long> last_tick;
+
+	// Discards a datagram.
+	static void discard(datagram_map::iterator it);
+
+	// Discards datagrams which have expired at packet time 'now'.
+	static void expire(const pdu_time& now);
+
+	// Copies fragment data into the buffer according to the overlap
+	// policy, and records the range.  Returns true if the fragment
+	// overlapped data already held.
+	static bool store(datagram& d, unsigned long first, unsigned long last,
+			  pdu_iter s);
+
+    };
+
+}
+}
+
+#endif
+
@@ -0,0 +1,153 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Length-prefixed message framing
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CYBERMON_LENGTH_FRAMER_H
+#define CYBERMON_LENGTH_FRAMER_H
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <cyberprobe/protocol/pdu.h>
+
+namespace cyberprobe {
+namespace protocol {
+
+    // Splits a reassembled stream into messages which are prefixed with
+    // a big-endian length, e.g. DNS over TCP (RFC 1035 4.2.2), which has
+    // a 2 byte prefix not counting itself.  Messages wholly within the
+    // data passed in are handed on in place, only a message split across
+    // data is gathered into a buffer.
+    class length_framer {
+    private:
+
+	// Length prefix size, 1 to 4 bytes.
+	unsigned int prefix;
+
+	// Longest message accepted.
+	uint32_t max_message;
+
+	// A message split across data, prefix included.  'needed' is the
+	// full size, prefix included, once the prefix has been seen.
+	pdu partial;
+	size_t needed;
+
+	// The last gathered message.  Swapped with 'partial', so the
+	// buffers are reused.
+	pdu complete;
+
+	// Set when a message is too long.  Framing is lost, the stream is
+	// ignored until reset.
+	bool lost;
+
+	uint32_t length(pdu_iter p) const {
+	    uint32_t len = 0;
+	    for(unsigned int i = 0; i < prefix; i++)
+		len = (len << 8) + p[i];
+	    return len;
+	}
+
+	// Works out the message size from the prefix in 'partial'.
+	void partial_prefix() {
+	    uint32_t len = length(partial.begin());
+	    if (len > max_message) {
+		lost = true;
+		partial.clear();
+		return;
+	    }
+	    needed = prefix + len;
+	    partial.reserve(needed);
+	}
+
+    public:
+
+	length_framer(unsigned int prefix = 2, uint32_t max_message = 65535)
+	    : prefix(prefix), max_message(max_message), needed(0),
+	      lost(false) {}
+
+	// Frames stream data s..e, calling fn(start, end) for each
+	// complete message, prefix excluded.  The iterators are valid until
+	// the next call of process: they point into s..e, or for a message
+	// gathered from earlier data, into the framer.
+	template <class F>
+	void process(pdu_iter s, pdu_iter e, F fn);
+
+	// Discards any partial message and regains framing.  Called when
+	// stream data is lost; the next data must start on a message.
+	void reset() {
+	    partial.clear();
+	    needed = 0;
+	    lost = false;
+	}
+
+	// True if framing has been lost on a bad length.
+	bool is_lost() const { return lost; }
+
+	// True if part of a message is held.
+	bool in_message() const { return !partial.empty(); }
+
+    };
+
+    template <class F>
+    void length_framer::process(pdu_iter s, pdu_iter e, F fn)
+    {
+
+	if (lost) return;
+
+	// Finish a message started in earlier data.
+	if (!partial.empty()) {
+
+	    if (partial.size() < prefix) {
+		size_t n = std::min<size_t>(prefix - partial.size(), e - s);
+		partial.insert(partial.end(), s, s + n);
+		s += n;
+		if (partial.size() < prefix) return;
+		partial_prefix();
+		if (lost) return;
+	    }
+
+	    size_t n = std::min<size_t>(needed - partial.size(), e - s);
+	    partial.insert(partial.end(), s, s + n);
+	    s += n;
+	    if (partial.size() < needed) return;
+
+	    complete.swap(partial);
+	    partial.clear();
+	    fn(complete.cbegin() + prefix, complete.cend());
+
+	}
+
+	// Messages wholly within the data.
+	while (size_t(e - s) >= prefix) {
+
+	    uint32_t len = length(s);
+	    if (len > max_message) {
+		lost = true;
+		return;
+	    }
+
+	    if (size_t(e - s) - prefix < len) break;
+
+	    fn(s + prefix, s + prefix + len);
+	    s += prefix + len;
+
+	}
+
+	// Start of a message which runs on into later data.
+	if (s != e) {
+	    partial.assign(s, e);
+	    if (partial.size() >= prefix)
+		partial_prefix();
+	}
+
+    }
+
+}
+}
+
+#endif
+
@@ -25,18 +25,15 @@ namespace protocol {
     public:
 	
 	// Constructor.
-        ntp_context(manager& m) : context(m) {
+        ntp_context(manager& m) : context(m, NTP_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         ntp_context(manager& m, const flow_address& a, context_ptr p) : 
-            context(m) { 
+            context(m, NTP_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type is "ntp".
-	virtual std::string get_type() { return "ntp"; }
-
 	typedef std::shared_ptr<ntp_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f, 
@@ -21,22 +21,16 @@ namespace protocol {
     public:
 
         // Construcotr.
-        pop3_context(manager& m) : context(m) {}
+        pop3_context(manager& m) : context(m, POP3_CONTEXT) {}
 
         // Constructor, when specifying flow address and parent context.
         pop3_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m)
+            : context(m, POP3_CONTEXT)
             { 
                 addr = a;
                 parent = p; 
             }
 
-        // Type is "pop3".
-        virtual std::string get_type()
-            {
-                return "pop3";
-            }
-
         typedef std::shared_ptr<pop3_context> ptr;
 
         static context_ptr create(manager& m, const flow_address& f, context_ptr par)
@@ -20,22 +20,16 @@ namespace protocol {
     public:
 
         // Construcotr.
-        pop3_ssl_context(manager& m) : context(m) {}
+        pop3_ssl_context(manager& m) : context(m, POP3_SSL_CONTEXT) {}
 
         // Constructor, when specifying flow address and parent context.
         pop3_ssl_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m)
+            : context(m, POP3_SSL_CONTEXT)
             { 
                 addr = a;
                 parent = p; 
             }
 
-        // Type is "pop3_ssl".
-        virtual std::string get_type()
-            {
-                return "pop3_ssl";
-            }
-
         typedef std::shared_ptr<pop3_ssl_context> ptr;
 
         static context_ptr create(manager& m, const flow_address& f, context_ptr par)
@@ -20,22 +20,16 @@ namespace protocol {
     public:
 
         // Constructor.
-        rtp_context(manager& m) : context(m) {}
+        rtp_context(manager& m) : context(m, RTP_CONTEXT) {}
 
         // Constructor, when specifying flow address and parent context.
         rtp_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m)
+            : context(m, RTP_CONTEXT)
             { 
                 addr = a;
                 parent = p; 
             }
 
-        // Type is "rtp".
-        virtual std::string get_type()
-            {
-                return "rtp";
-            }
-
         typedef std::shared_ptr<rtp_context> ptr;
 
         static context_ptr create(manager& m, const flow_address& f, context_ptr par)
@@ -16,13 +16,16 @@
 #include <cyberprobe/protocol/manager.h>
 #include <cyberprobe/util/serial.h>
 
+// OpenSSL digest context, only used by pointer here.
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
 namespace cyberprobe {
 namespace protocol {
 
     // SMTP client parser.
     class smtp_client_parser {
     public:
-        virtual ~smtp_client_parser() {}
+        virtual ~smtp_client_parser();
 
     private:
 
@@ -32,20 +35,64 @@ namespace protocol {
 
 	} state;
 
+	// Bytes of the DATA terminator, CRLF . CRLF, matched so far.  They
+	// are held back from the message until the match fails.  The CRLF
+	// ending the DATA command counts, so a message starts with 2
+	// matched, of which 'term_implied' weren't message data.
+	unsigned int term_matched;
+	unsigned int term_implied;
+
+	// Message size, including bytes beyond the capture limit.
+	unsigned long data_size;
+
+	// SHA-256 of the message as it streams past, when hashing.
+	EVP_MD_CTX* hash;
+
+	// Parses message data from s..e.  Returns the position after the
+	// terminator, or e if the message hasn't ended.
+	pdu_iter parse_data(context_ptr cp, pdu_iter s, pdu_iter e,
+			    const pdu_time& time, manager& mgr);
+
+	// Adds message data, hashing it, and capturing it up to the data
+	// limit.  Data beyond the limit is skipped.
+	void capture_data(const unsigned char* s, size_t n);
+
+	// Readies for a new message.
+	void start_data();
+
+	// Finishes the message, raising the event.
+	void complete_data(context_ptr cp, const pdu_time& time,
+			   manager& mgr);
+
+	// Data allocations larger than this are released when a message
+	// completes.
+	static const unsigned long retained_data_capacity = 65536;
+
     public:
 
+	// Default message capture limit (bytes) for new SMTP flows.  Zero
+	// means no limit.
+	static unsigned long long default_data_limit;
+
+	// Whether new SMTP flows hash messages.
+	static bool hash_data;
+
+	// Message capture limit (bytes) for this flow.  Zero means no
+	// limit.
+	unsigned long long data_limit;
+
 	smtp_client_parser() {
 	    state = IN_COMMAND;
-	    exp_terminator = "\r\n.\r\n";
+	    term_matched = term_implied = 0;
+	    data_size = 0;
+	    hash = 0;
+	    data_limit = default_data_limit;
 	}
 
 	// For the request.
 	std::string command;
 	std::vector<unsigned char> data;
 
-	std::string terminator;
-	std::string exp_terminator;
-
 	std::string from;
 	std::list<std::string> to;
 
@@ -95,19 +142,16 @@ namespace protocol {
 	
 	// Constructor.
         smtp_client_context(manager& m) : 
-            context(m) {
+            context(m, SMTP_CLIENT_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         smtp_client_context(manager& m, const flow_address& a, 
 			    context_ptr p) : 
-            context(m) { 
+            context(m, SMTP_CLIENT_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type.
-	virtual std::string get_type() { return "smtp_client"; }
-
 	typedef std::shared_ptr<smtp_client_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
@@ -132,19 +176,16 @@ namespace protocol {
 	
 	// Constructor.
         smtp_server_context(manager& m) : 
-            context(m) {
+            context(m, SMTP_SERVER_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         smtp_server_context(manager& m, const flow_address& a, 
 			    context_ptr p) : 
-            context(m) { 
+            context(m, SMTP_SERVER_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type.
-	virtual std::string get_type() { return "smtp_server"; }
-
 	typedef std::shared_ptr<smtp_server_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f,
@@ -170,8 +211,8 @@ namespace protocol {
         // SMTP request processing function.
         static void process(manager&, context_ptr c, const pdu_slice& sl);
 
-    private:
-
+        // The client / server functions are used directly when the stream
+        // is identified by content rather than port number.
 
         // SMTP client request processing function.
         static void process_client(manager&, context_ptr c,
@@ -10,26 +10,87 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
 #include <set>
 
 #include <cyberprobe/protocol/context.h>
+#include <cyberprobe/protocol/length_framer.h>
 #include <cyberprobe/protocol/manager.h>
 #include <cyberprobe/util/serial.h>
 #include <cyberprobe/protocol/process.h>
 #include <cyberprobe/protocol/tcp_ports.h>
+#include <cyberprobe/protocol/tcp_ident.h>
 
 
 namespace cyberprobe {
 namespace protocol {
 
+    // An out-of-order segment, queued for reassembly.  Positions are
+    // absolute stream offsets, so aren't affected by sequence number
+    // wrap.  The segment is keyed on its first position.
     class tcp_segment {
     public:
-	std::vector<unsigned char> segment;
-	uint32_t first;
-	uint32_t last;
-	bool operator<(const tcp_segment& s) const {
-	    return first < s.first;
-	}
+	pdu segment;
+	uint64_t last;
+    };
+
+    class tcp_context;
+
+    // Reassembly state shared by all TCP flows.  Segment payload buffers
+    // are recycled through a pool, and the total payload queued across all
+    // flows, plus the buffers held in the pool, is held within a memory
+    // limit.  When the limit is exceeded, the pool is trimmed first, then
+    // the least-recently-queued-to flows have their queues discarded, and
+    // resynchronise on their next segment, reporting a gap.
+    class tcp_reassembly {
+    private:
+
+	static std::mutex mutex;
+
+	// Free payload buffers.
+	static std::vector<pdu> pool;
+	static const unsigned int max_pool = 4096;
+
+	// Capacity of the buffers in the pool.
+	static unsigned long long pooled;
+
+	// Queued payload bytes across all flows.
+	static unsigned long long used;
+
+	// Puts a buffer on the pool if it fits within the pool size and
+	// memory limit, otherwise frees it.  Caller holds the mutex.
+	static void recycle(pdu& buf);
+
+	// Flows with queued data, most recently queued-to first.
+	static std::list<tcp_context*> lru;
+
+	// Discards a flow's queued segments.  Caller holds the mutex, and
+	// the flow's lock.
+	static void evict(tcp_context* tc);
+
+    public:
+
+	// Memory limit for queued segment payload and pooled buffers, in
+	// bytes.
+	static unsigned long long memory_limit;
+
+	// Gets a buffer from the pool, holding the data s..e.
+	static void acquire(pdu& buf, pdu_iter s, pdu_iter e);
+
+	// Returns a buffer to the pool.
+	static void release(pdu& buf);
+
+	// Records a change in the bytes queued on a flow.  Caller holds the
+	// flow's lock.  May discard queued data, on this or other flows, to
+	// keep within the memory limit.
+	static void queued(tcp_context* tc, long long delta);
+
+	// Removes a flow from reassembly accounting.
+	static void remove(tcp_context* tc);
+
     };
     
     // A TCP context.
@@ -42,9 +103,10 @@ namespace protocol {
 	bool fin_observed;
 	bool connected;
 
-	// Buffer for data for identification.
+	// Buffer for data for identification, only used when the first
+	// segment is too short to identify.
 	static const unsigned int ident_buffer_max;
-	std::string ident_buffer;
+	pdu ident_buffer;
 
 	// Once identified, the processing function.
 	bool svc_idented;
@@ -58,14 +120,52 @@ namespace protocol {
 	// Sequence number, only used in packet forgery.
 	serial ack_received;
 
+	// Absolute stream position of seq_expected.
+	uint64_t stream_pos;
+
 	// Segments buffer for reassembly.
 	static const unsigned int max_segments;
-	std::set<tcp_segment> segments;
-	
+	std::map<uint64_t, tcp_segment> segments;
+
+	// Reassembly accounting, managed by tcp_reassembly.
+	unsigned long long queued_bytes;
+	bool in_lru;
+	std::list<tcp_context*>::iterator lru_pos;
+
+	// Set when queued segments have been discarded.  The next segment
+	// resynchronises the stream.
+	bool resync;
+
+	// Set when the flow is bypassed.  Packets only update the bypass
+	// counters, there is no reassembly, parsing or events.  Atomic, as
+	// the reverse direction reads it.
+	std::atomic<bool> bypassed;
+	uint64_t bypass_packets;
+	uint64_t bypass_bytes;
+
+	// Message framing for length-prefixed protocols e.g. DNS over TCP.
+	// Lives here rather than in a child context so that gaps in the
+	// stream reset it.  Only used by the processor.
+	length_framer framer;
+
+	// Bypasses this direction, discarding queued data.  Caller holds
+	// the lock.
+	void set_bypassed();
+
+	// Queues an out-of-order segment, trimming overlap with segments
+	// already queued.  Where segments partially overlap, data already
+	// queued wins.  Caller holds the lock.
+	void queue_segment(uint64_t first, uint64_t last,
+			   pdu_iter s, pdu_iter e);
+
+	// Removes a segment from the queue.  Caller holds the lock.
+	std::map<uint64_t, tcp_segment>::iterator
+	discard_segment(std::map<uint64_t, tcp_segment>::iterator it);
+
 
 	// Constructor, describing flow address and parent pointer.
         tcp_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m) { 
+            : context(m, TCP_CONTEXT) { 
 	    addr = a;
 	    parent = p; 
 	    syn_observed = false;
@@ -73,16 +173,29 @@ namespace protocol {
 	    svc_idented = false;
 	    processor = 0;
 	    fin_observed = false;
+	    stream_pos = 0;
+	    queued_bytes = 0;
+	    in_lru = false;
+	    resync = false;
+	    bypassed = false;
+	    bypass_packets = 0;
+	    bypass_bytes = 0;
 
 	    // Only need to initialise handlers once
 	    if (!tcp_ports::is_handlers_init())
 		{
 		    tcp_ports::init_handlers();
 		}
+
+	    if (!tcp_ident::is_signatures_init())
+		tcp_ident::init_signatures();
 	}
 
-	// Type is "tcp".
-	virtual std::string get_type() { return "tcp"; }
+	virtual ~tcp_context() {
+	    tcp_reassembly::remove(this);
+	    for(auto& s : segments)
+		tcp_reassembly::release(s.second.segment);
+	}
 
 	typedef std::shared_ptr<tcp_context> ptr;
 
@@ -136,6 +249,26 @@ namespace protocol {
 	static void post_process(manager&, tcp_context::ptr c,
 				 const pdu_slice& sl);
 
+	// Context kinds whose parsers bypass their flow once it is
+	// classified: TLS once application data starts, unrecognised
+	// streams straight away.
+	static std::set<context_kind> bypass_kinds;
+
+	// Bypasses the TCP flow which 'c' is part of, in both directions.
+	// Queued data is discarded.  Returns false if 'c' isn't part of a
+	// TCP flow.
+	static bool bypass(context_ptr c);
+
+	// Called by parsers when they have classified a flow, bypasses the
+	// flow if configured for the parser's kind.
+	static void classified(context_ptr c) {
+	    if (bypass_kinds.find(c->kind) != bypass_kinds.end())
+		bypass(c);
+	}
+
+	// Finds the TCP context which 'c' is part of.  Null if none.
+	static tcp_context::ptr find(context_ptr c);
+
     };
 
 }
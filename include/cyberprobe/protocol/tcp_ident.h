@@ -0,0 +1,81 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// TCP stream identification by content
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CYBERMON_TCP_IDENT_H
+#define CYBERMON_TCP_IDENT_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <cyberprobe/protocol/pdu.h>
+#include <cyberprobe/protocol/process.h>
+
+namespace cyberprobe {
+namespace protocol {
+
+    // Identifies a stream protocol from the leading bytes of a TCP stream.
+    // Signatures are byte-string prefixes, compiled into a trie with a
+    // 256-way transition table per node, so identification is a single
+    // pass over the data with no allocation.  Where signatures overlap,
+    // the longest match wins.
+    class tcp_ident
+    {
+
+    public:
+
+	typedef enum {
+	    MATCHED,       // Signature matched, processor is set.
+	    NOT_MATCHED,   // No signature can match.
+	    NEED_MORE      // Could match given more data.
+	} result;
+
+    private:
+
+	// A trie node.  Transitions are node indices, 0 = no transition
+	// (node 0 is the root, which is never a transition target).
+	class node {
+	public:
+	    uint16_t next[256];
+	    process_fn processor;
+	    node() : processor(0) {
+		std::fill(next, next + 256, 0);
+	    }
+	};
+
+	static std::vector<node> nodes;
+
+	static std::atomic<bool> signatures_initialised;
+
+    public:
+
+	static void init_signatures(void);
+
+	static bool is_signatures_init(void);
+
+	// Adds a signature.  If the signature already exists, the
+	// processing function is replaced.
+	static void add_signature(const std::string& prefix, process_fn fn);
+
+	// Attempt to identify the data s..e.  On MATCHED, 'fn' is set to
+	// the processing function of the longest matching signature.
+	// NEED_MORE is returned if a longer signature could still match,
+	// unless 'final' is set, in which case the best match so far is
+	// used.
+	static result identify(pdu_iter s, pdu_iter e, process_fn& fn,
+			       bool final = false);
+
+    }; // End class
+
+}
+}
+
+#endif
+
@@ -0,0 +1,33 @@
+
+#ifndef CYBERMON_TLS_FINGERPRINT_H
+#define CYBERMON_TLS_FINGERPRINT_H
+
+#include <cyberprobe/protocol/pdu.h>
+
+#include <string>
+
+namespace cyberprobe {
+namespace protocol {
+    namespace tls_fingerprint {
+
+        using pdu_iter = cyberprobe::protocol::pdu_iter;
+
+        // Computes the JA3 hash and JA4 fingerprint of a ClientHello.
+        // 's' to 'e' is the hello body, starting at the version.  GREASE
+        // values are ignored.  Returns false, leaving the strings empty,
+        // if the hello is too short to fingerprint.
+        bool client(pdu_iter s, pdu_iter e, std::string& ja3,
+                    std::string& ja4);
+
+        // Computes the JA3S hash of a ServerHello body.
+        bool server(pdu_iter s, pdu_iter e, std::string& ja3s);
+
+        // Lower-case hex digests.
+        std::string md5(const std::string& data);
+        std::string sha256(const std::string& data);
+
+    } // tls_fingerprint
+}
+} // cybermon
+
+#endif
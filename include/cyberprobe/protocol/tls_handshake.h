@@ -15,6 +15,10 @@ namespace protocol {
         using tls = cyberprobe::protocol::tls;
         using pdu_slice = cyberprobe::protocol::pdu_slice;
     public:
+        // If false, hello events leave out the cipher suite, compression
+        // method and extension lists, and carry only the fingerprints.
+        static bool hello_lists;
+
         static void process(manager& mgr, tls_context::ptr ctx, const pdu_slice& pduSlice, const tls::header* hdr);
     private:
         static void clientHello(manager& mgr, tls_context::ptr ctx, const pdu_slice& pduSlice, uint16_t length);
@@ -69,8 +69,14 @@ namespace protocol {
             std::vector<compression_method> compressionMethods;
             std::vector<extension> extensions;
 
+            // JA3 hash and JA4 fingerprint, empty if the hello couldn't
+            // be fingerprinted.
+            std::string ja3;
+            std::string ja4;
+
             client_hello_data() {}
-            client_hello_data(const client_hello_data& other) : hello_base(other)
+            client_hello_data(const client_hello_data& other)
+                : hello_base(other), ja3(other.ja3), ja4(other.ja4)
                 {
                     // deep copy data
                     cipherSuites.reserve(other.cipherSuites.size());
@@ -88,10 +94,13 @@ namespace protocol {
             compression_method compressionMethod;
             std::vector<extension> extensions;
 
+            // JA3S hash.
+            std::string ja3s;
+
             server_hello_data() {}
             server_hello_data(const server_hello_data& other)
                 : hello_base(other), cipherSuite(other.cipherSuite),
-                  compressionMethod(other.compressionMethod)
+                  compressionMethod(other.compressionMethod), ja3s(other.ja3s)
                 {
                     // deep copy data
                     extensions.reserve(other.extensions.size());
@@ -28,7 +28,7 @@ namespace protocol {
 
         // Constructor, when specifying flow address and parent context.
         udp_context(manager& m, const flow_address& a, context_ptr p)
-            : context(m)
+            : context(m, UDP_CONTEXT)
             { 
                 addr = a;
                 parent = p; 
@@ -40,9 +40,6 @@ namespace protocol {
                     }
             }
 
-	// Type is "udp".
-	virtual std::string get_type() { return "udp"; }
-
 	typedef std::shared_ptr<udp_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f, 
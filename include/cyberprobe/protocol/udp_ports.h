@@ -11,6 +11,7 @@
 #include <cyberprobe/protocol/context.h>
 #include <cyberprobe/protocol/manager.h>
 #include <cyberprobe/protocol/pdu.h>
+#include <atomic>
 #include <vector>
 
 namespace cyberprobe {
@@ -26,7 +27,7 @@ namespace protocol {
 
         static std::vector<fn> port_handler;
 
-        static bool handlers_initialised;
+        static std::atomic<bool> handlers_initialised;
 
     public:
 
@@ -28,21 +28,18 @@ namespace protocol {
 	
 	// Constructor.
         unrecognised_stream_context(manager& m) : 
-            context(m) {
+            context(m, UNRECOGNISED_STREAM_CONTEXT) {
             position = 0;
 	}
 
 	// Constructor, describing flow address and parent pointer.
         unrecognised_stream_context(manager& m, const flow_address& a, 
 				    context_ptr p) : 
-            context(m) { 
+            context(m, UNRECOGNISED_STREAM_CONTEXT) { 
 	    addr = a; parent = p;
             position = 0;
 	}
 
-	// Type.
-	virtual std::string get_type() { return "unrecognised_stream"; }
-
 	typedef std::shared_ptr<unrecognised_stream_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f, 
@@ -72,19 +69,16 @@ namespace protocol {
 	
 	// Constructor.
         unrecognised_datagram_context(manager& m) : 
-            context(m) {
+            context(m, UNRECOGNISED_DATAGRAM_CONTEXT) {
 	}
 
 	// Constructor, describing flow address and parent pointer.
         unrecognised_datagram_context(manager& m, const flow_address& a, 
 				      context_ptr p) : 
-            context(m) { 
+            context(m, UNRECOGNISED_DATAGRAM_CONTEXT) { 
 	    addr = a; parent = p; 
 	}
 
-	// Type.
-	virtual std::string get_type() { return "unrecognised_datagram"; }
-
 	typedef std::shared_ptr<unrecognised_datagram_context> ptr;
 
 	static context_ptr create(manager& m, const flow_address& f, 
@@ -18,7 +18,9 @@
 //   and 'stop' methods to get it to start and stop the resource.
 //
 // You then call the 'check' method on your resource manager periodically
-// to get it to check the configuration file for changes.
+// to get it to check the configuration file for changes.  Calling 'wait'
+// between checks sleeps until the file changes, where the platform can
+// tell us.
 
 #ifndef CYBERPROBE_RESOURCE_H
 #define CYBERPROBE_RESOURCE_H
@@ -60,6 +62,13 @@ namespace resources {
         // Time of last file update.
         long last_update;
 
+        // inotify descriptor watching the configuration file's directory,
+        // or -1 if not watching.
+        int notify_fd;
+
+        // Set when a change to the configuration file has been notified.
+        bool notified;
+
     protected:
 
         // Returns true if the file has been modified since the specified
@@ -79,6 +88,11 @@ namespace resources {
         // to meet the new specification list.
         virtual void update(std::map<std::string, specification*>& upd);
 
+        // Called before and after the resource starts and stops of an
+        // update, so that the changes can be applied as a batch.
+        virtual void begin_changes() {}
+        virtual void end_changes() {}
+
     protected:
 
         // Users should implement this - it knows how to turn specifications
@@ -86,7 +100,9 @@ namespace resources {
         virtual resource* create(specification& spec) = 0;
 
         // Users should implement this method to implement configuration
-        // file scanning.
+        // file scanning.  Throws an exception if the file can't be read in
+        // full, leaving the list empty, and the current resources are
+        // kept.
         virtual void read(const std::string& file,
                           std::list<specification*>&) = 0;
 
@@ -97,10 +113,12 @@ namespace resources {
             // Set last update time to 1970, making certain the configuration
             // file will be read on next update.
             last_update = 0;
+            notify_fd = -1;
+            notified = false;
         }
 
         // Destructor.
-        virtual ~resource_manager() { }
+        virtual ~resource_manager();
 
         // Called to initiate a re-scan of the configuration file.  You
         // should probably call the 'check' method so that the configuration
@@ -111,6 +129,10 @@ namespace resources {
         // configuration file has changed, will initiate an update.
         void check(const std::string& file);
 
+        // Waits up to 'timeout' seconds for the configuration file to
+        // change.  Uses inotify where available, otherwise just sleeps.
+        void wait(const std::string& file, int timeout = 1);
+
         // Reads the contents of a file into a string.
         static void get_file(const std::string& f, std::string& str);
 
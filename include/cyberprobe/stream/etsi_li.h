@@ -153,6 +153,23 @@ namespace cyberprobe {
                          const std::string& int_pt = "",
                          direction = direction::NOT_KNOWN);
 
+            // Encodes the Payload of an IP packet PDU.  The Payload
+            // doesn't depend on the LIID, so a packet delivered for
+            // several LIIDs need only be encoded once.
+            static void encode_ip_payload(std::vector<unsigned char>& payload,
+                                          const std::vector<unsigned char>& packet,
+                                          direction dir = direction::NOT_KNOWN);
+
+            // Sends an IP packet PDU, given the encoded Payload.
+            void send_ip_payload(timeval tv,
+                                 const std::string& liid,
+                                 const std::string& oper,
+                                 uint32_t seq, uint32_t cid,
+                                 const std::vector<unsigned char>& payload,
+                                 const std::string& country = "",
+                                 const std::string& net_element = "",
+                                 const std::string& int_pt = "");
+
             void ia_acct_stop(const std::string& liid,
                               const std::string& oper,
                               uint32_t seq, uint32_t cin,
@@ -212,6 +229,16 @@ namespace cyberprobe {
                            const std::string& int_pt = "",
                            direction dir = direction::NOT_KNOWN);
 
+            // As target_ip, given the Payload encoded by
+            // sender::encode_ip_payload.
+            void target_ip_payload(timeval tv,
+                                   const std::string& liid,
+                                   const std::vector<unsigned char>& payload,
+                                   const std::string& oper = "unknown",
+                                   const std::string& country = "",
+                                   const std::string& net_elt = "",
+                                   const std::string& int_pt = "");
+
         };
 
         class receiver;
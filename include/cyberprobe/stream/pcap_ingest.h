@@ -0,0 +1,168 @@
+
+/****************************************************************************
+
+Parallel PCAP file ingest.
+
+Reads capture files for cybermon much faster than one libpcap reader thread
+can.  Classic PCAP files are mapped into memory, others (pcapng, compressed
+files, standard input) are streamed through capture_file and their packets
+copied.  A dispatcher thread walks the records, handing them in batches to
+a set of shard threads, each of which runs packets through the monitor.
+Packets are sent to a shard by a hash of their IP addresses, which is the
+same both ways, so a flow, and the fragments of a datagram, are always
+handled by the same shard, in capture order.  There is no ordering between
+flows on different shards.
+
+With packet time expiry, the clock is moved by the reader rather than by
+each packet, and only as far as the earliest packet a shard has still to
+handle, so a shard which falls behind doesn't see its flows expired by
+the time the others have reached.
+
+Files are read one after another, in the order given.  A directory stands
+for the files in it, in name order.
+
+****************************************************************************/
+
+#ifndef CYBERPROBE_PCAP_INGEST_H
+#define CYBERPROBE_PCAP_INGEST_H
+
+#include <cyberprobe/analyser/monitor.h>
+#include <cyberprobe/util/reaper.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cyberprobe {
+
+    namespace pcap_ingest {
+
+        // A classic PCAP file, mapped read-only.  Throws runtime_error if
+        // the file can't be mapped, or isn't an uncompressed classic PCAP
+        // file.
+        class mapped_file {
+        private:
+            const unsigned char* base;
+            size_t size;
+
+            // Position of the next record.
+            size_t pos;
+
+            // Header is in the other byte order.
+            bool swapped;
+
+            // Timestamps are in nanoseconds.
+            bool nano;
+
+            uint32_t get32(const unsigned char* p) const {
+                uint32_t v;
+                memcpy(&v, p, 4);
+                return swapped ? __builtin_bswap32(v) : v;
+            }
+
+        public:
+
+            std::string path;
+
+            // Link type from the file header.
+            uint32_t linktype;
+
+            mapped_file(const std::string& path);
+            ~mapped_file();
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            // Returns the next record, pointing into the mapping.  False
+            // at the end of the file, or if the last record is cut short.
+            bool next(timeval& tv, const unsigned char*& data,
+                      uint32_t& len);
+
+            // True if the file ended part way through a record.
+            bool truncated() const { return pos < size; }
+
+        };
+
+        // Reads capture files into a monitor, see above.
+        class reader {
+
+        private:
+
+            std::vector<std::string> files;
+            analyser::monitor& mon;
+            std::string device;
+            unsigned int shards;
+            util::reaper* clock;
+
+            std::atomic<bool> running;
+            std::atomic<bool> errors;
+            std::thread* thr;
+
+        public:
+
+            // Records per batch handed to a shard.
+            static const unsigned int batch_size = 256;
+
+            // Batches queued on a shard before the dispatcher waits.
+            // Bounds the memory held for packets in flight.
+            static const unsigned int max_batches = 64;
+
+            // 'clock' is the reaper expiring the monitor's state, if it
+            // uses packet time.
+            reader(const std::vector<std::string>& files,
+                   analyser::monitor& mon, const std::string& device,
+                   unsigned int shards, util::reaper* clock = nullptr) :
+                files(files), mon(mon), device(device),
+                shards(shards ? shards : 1), clock(clock), running(true),
+                errors(false), thr(nullptr) {}
+
+            virtual ~reader() {}
+
+            virtual void run();
+
+            // Boot thread.
+            void start() {
+                thr = new std::thread(&reader::run, this);
+            }
+
+            virtual void join() {
+                if (thr)
+                    thr->join();
+            }
+
+            // Stops reading.  Packets already dispatched are still
+            // processed.
+            virtual void stop() {
+                running = false;
+            }
+
+            // True if a file couldn't be read, or was corrupt.
+            bool failed() const { return errors; }
+
+            // Expands directories in a list of paths to the files in them,
+            // in name order.  Other paths are kept as they are.
+            static std::vector<std::string>
+            expand(const std::vector<std::string>& paths);
+
+            // Returns the offset of the IP header in a frame of the given
+            // link type, or -1 if the frame doesn't carry IP.
+            static int ip_offset(uint32_t linktype, const unsigned char* f,
+                                 uint32_t len);
+
+            // Hash of a packet's IP addresses, the same in both directions.
+            static uint32_t flow_hash(const unsigned char* ip, uint32_t len);
+
+        };
+
+    };
+
+};
+
+#endif
+
@@ -61,11 +61,6 @@ public:
 
 	    unsigned int mask = it->first;
 
-	    A th = a & mask;
-	    std::string th2;
-	    a.to_string(th2);
-	    th.to_string(th2);
-
 	    it2 = it->second.find(a & mask);
 
 	    if (it2 != it->second.end()) {
@@ -80,6 +75,32 @@ public:
 
     }
 
+    // Searches the map for every key which matches address 'a', most
+    // specific first.  Calls f(t, hit) for each, with the value and hit
+    // key.  Returns the number of matches.
+    template <class F>
+    unsigned int get_all(const A& a, F f) {
+
+	unsigned int count = 0;
+
+	typename mask_map::reverse_iterator it;
+
+	for(it = m.rbegin(); it != m.rend(); it++) {
+
+	    typename std::map<A, T>::iterator it2 =
+		it->second.find(a & it->first);
+
+	    if (it2 != it->second.end()) {
+		f(it2->second, it2->first);
+		count++;
+	    }
+
+	}
+
+	return count;
+
+    }
+
     // Searches the map for address 'a'.  If it exists, returns true and
     // a pointer to the value is returned in 't'.  Otherwise, returns false,
     // and t is undefined.
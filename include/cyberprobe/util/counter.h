@@ -0,0 +1,197 @@
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Statistics counters
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CYBERPROBE_COUNTER_H
+#define CYBERPROBE_COUNTER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cyberprobe {
+
+namespace util {
+
+    // A counter which many threads can add to without contention.  Each
+    // thread adds to its own shard, on its own cache line, and reading
+    // sums the shards.
+    class counter {
+    public:
+
+	static const unsigned int shards = 16;
+
+    private:
+
+	// Padded so that no two shards' values share a cache line.  Padding
+	// rather than alignment, as counters are members of heap objects.
+	struct shard {
+	    std::atomic<uint64_t> value;
+	    char pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	shard shard_[shards];
+
+    public:
+
+	// Shard used by the calling thread.  Threads are assigned shards
+	// in turn.
+	static unsigned int thread_shard() {
+	    static std::atomic<unsigned int> next(0);
+	    static thread_local unsigned int mine = next++ % shards;
+	    return mine;
+	}
+
+	counter() {
+	    for(unsigned int i = 0; i < shards; i++)
+		shard_[i].value.store(0, std::memory_order_relaxed);
+	}
+
+	void add(uint64_t n = 1) {
+	    shard_[thread_shard()].value.fetch_add(n,
+						   std::memory_order_relaxed);
+	}
+
+	uint64_t get() const {
+	    uint64_t total = 0;
+	    for(unsigned int i = 0; i < shards; i++)
+		total += shard_[i].value.load(std::memory_order_relaxed);
+	    return total;
+	}
+
+    };
+
+    // Packet and byte counts for a set of keys, e.g. per target.  Keys
+    // are given a slot number off the packet path, and hold it while in
+    // use.  Each thread counting keeps its own table of slots, which only
+    // it writes, so counting is two uncontended stores.  Reading sums
+    // every thread's table.
+    class counter_table {
+    public:
+
+	// Counts for a key.
+	class counts {
+	public:
+	    uint64_t packets;
+	    uint64_t bytes;
+	    counts() : packets(0), bytes(0) {}
+	};
+
+    private:
+
+	// Slots are held in fixed-size chunks, which never move once
+	// allocated, so a thread's table can grow while it is read.
+	static const unsigned int chunk_size = 1024;
+	static const unsigned int max_chunks = 4096;
+
+	struct cell {
+	    std::atomic<uint64_t> packets;
+	    std::atomic<uint64_t> bytes;
+	    cell() : packets(0), bytes(0) {}
+	};
+
+	struct chunk {
+	    cell cells[chunk_size];
+	};
+
+	// One thread's table.
+	struct shard {
+	    std::atomic<chunk*> chunks[max_chunks];
+	    shard() {
+		for(unsigned int i = 0; i < max_chunks; i++)
+		    chunks[i].store(0, std::memory_order_relaxed);
+	    }
+	    ~shard() {
+		for(unsigned int i = 0; i < max_chunks; i++)
+		    delete chunks[i].load(std::memory_order_relaxed);
+	    }
+	};
+
+	// Protects the slot allocation and shard list.
+	std::mutex mutex;
+
+	std::map<std::string, unsigned int> slots;
+
+	// Per slot: key, users, and the counts when the slot was last
+	// taken, as threads' cells aren't cleared when a slot is re-used.
+	std::vector<std::string> keys;
+	std::vector<unsigned int> users;
+	std::vector<counts> base;
+
+	// Slots given back, for re-use.
+	std::vector<unsigned int> free_slots;
+
+	std::map<std::thread::id, std::unique_ptr<shard> > threads;
+
+	// Table number, so that threads can cache their shard.
+	uint64_t id;
+
+	// Tables whose shards a thread keeps cached.
+	static const unsigned int cached_tables = 8;
+
+	// Returns the calling thread's shard.
+	shard& get_shard();
+
+	// Sums every thread's counts for a slot.  Caller holds the mutex.
+	counts sum(unsigned int slot);
+
+    public:
+
+	// Slot shared by keys which arrive when the table is full.
+	static const unsigned int overflow = 0;
+	static const std::string overflow_key;
+
+	counter_table();
+
+	// Returns the slot for 'key', allocating one if needed, and counts
+	// the caller as a user.  If the table is full, returns the
+	// overflow slot.
+	unsigned int slot(const std::string& key);
+
+	// A user of 'slot' is done with it.  When the last user is gone,
+	// the key's counts are dropped and the slot re-used.
+	void release(unsigned int slot);
+
+	// Counts a packet of 'bytes' against 'slot'.
+	void add(unsigned int slot, uint64_t bytes) {
+
+	    shard& s = get_shard();
+
+	    chunk* c = s.chunks[slot / chunk_size].load(
+		std::memory_order_relaxed);
+	    if (c == 0) {
+		c = new chunk();
+		s.chunks[slot / chunk_size].store(c,
+						  std::memory_order_release);
+	    }
+
+	    cell& cl = c->cells[slot % chunk_size];
+	    cl.packets.store(cl.packets.load(std::memory_order_relaxed) + 1,
+			     std::memory_order_relaxed);
+	    cl.bytes.store(cl.bytes.load(std::memory_order_relaxed) + bytes,
+			   std::memory_order_relaxed);
+
+	}
+
+	// Sums the counts for every key in use.  Overflow counts are
+	// under 'overflow_key', if there are any.
+	void get(std::map<std::string, counts>& out);
+
+    };
+
+};
+
+};
+
+#endif
+
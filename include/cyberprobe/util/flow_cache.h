@@ -0,0 +1,139 @@
+
+// Direct-mapped flow cache.
+//
+// This header provides a template class flow_cache<N, V> which remembers
+// the result of looking up a (source, destination) address pair, where
+// addresses are N bytes long.  The result is a value of type V, which the
+// caller fills in, and which is left in place when the entry is re-used,
+// so that e.g. a container's storage is re-used too.  Each slot holds one
+// pair, a new pair replaces whatever was in its slot.
+//
+// Entries are stamped with a generation number, the caller bumps the
+// generation whenever the underlying table changes, which invalidates
+// every entry at once.
+//
+// A cache is not thread-safe, local() returns a cache for the calling
+// thread.  Tables are told apart by a number from new_cache_owner(), not
+// their address, which a new table may be given once an old one is gone.
+
+#ifndef FLOW_CACHE_H
+#define FLOW_CACHE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+
+namespace cyberprobe {
+namespace util {
+
+// Returns a number which identifies a table to local(), never returned
+// before.
+inline uint64_t new_cache_owner() {
+    static std::atomic<uint64_t> next(1);
+    return next++;
+}
+
+template <unsigned int N, class V>
+class flow_cache {
+
+    static_assert(N % 4 == 0, "Address length must be a multiple of 4");
+
+public:
+
+    static const unsigned int size = 4096;
+
+    class entry {
+    public:
+
+	uint64_t generation;
+	unsigned char src[N];
+	unsigned char dst[N];
+
+	// Lookup result.
+	V value;
+
+	// True if this entry holds the result for 's' / 'd' in generation
+	// 'gen'.
+	template <class I>
+	bool valid(uint64_t gen, I s, I d) const {
+	    return generation == gen &&
+		memcmp(src, &*s, N) == 0 && memcmp(dst, &*d, N) == 0;
+	}
+
+	// Marks the entry as holding no result, while 'value' is changed.
+	void invalidate() {
+	    generation = ~uint64_t(0);
+	}
+
+	// Marks 'value' as the result for 's' / 'd' in generation 'gen'.
+	template <class I>
+	void set(uint64_t gen, I s, I d) {
+	    generation = gen;
+	    memcpy(src, &*s, N);
+	    memcpy(dst, &*d, N);
+	}
+
+    };
+
+private:
+
+    uint64_t owner;
+    entry entries[size];
+
+    void clear() {
+	for(unsigned int i = 0; i < size; i++)
+	    entries[i].invalidate();
+    }
+
+public:
+
+    flow_cache() : owner(0) { clear(); }
+
+    // Returns the slot for the address pair at 's' and 'd', which must
+    // point at N contiguous bytes each.
+    template <class I>
+    entry& find(I s, I d) {
+
+	uint32_t h = 2166136261u;
+	for(unsigned int i = 0; i < N; i += 4) {
+	    uint32_t a, b;
+	    memcpy(&a, &*s + i, 4);
+	    memcpy(&b, &*d + i, 4);
+	    h = (h ^ a) * 0x9e3779b1u;
+	    h = (h ^ b) * 0x85ebca77u;
+	}
+	h ^= h >> 15;
+
+	return entries[h & (size - 1)];
+
+    }
+
+    // Returns the calling thread's cache for the table 'o', see
+    // new_cache_owner.  The cache is emptied if the thread last used it
+    // for a different table.
+    static flow_cache& local(uint64_t o) {
+
+	// Allocated on first use, so that threads which never look up
+	// don't carry a cache.
+	static thread_local std::unique_ptr<flow_cache> c;
+
+	if (!c) c.reset(new flow_cache());
+
+	if (c->owner != o) {
+	    c->clear();
+	    c->owner = o;
+	}
+
+	return *c;
+
+    }
+
+};
+
+};
+};
+
+#endif
+
@@ -2,6 +2,10 @@
 #ifndef CYBERMON_REAPER_H
 #define CYBERMON_REAPER_H
 
+#include <time.h>
+#include <sys/time.h>
+
+#include <atomic>
 #include <map>
 #include <set>
 #include <list>
@@ -40,10 +44,19 @@ public:
 	r.self_reaped(*this);
     }
 
-    virtual void reap() = 0;
+    // Removes the item.  Called with the reaper's lock held, while the
+    // item's owners may hold their own locks waiting to set a TTL, so this
+    // mustn't wait on a lock.  Returns false if it would have to, and it
+    // is tried again a second later.
+    virtual bool reap() = 0;
 
 };
 
+// Expires reapable objects once their TTL has passed.  By default, time is
+// wall-clock, and expiry is done by a thread, see start().  In packet time
+// mode, the clock is advanced by packet timestamps through advance(), and
+// expiry is done inline by the caller, so that processing a capture file
+// faster than real time still expires things as it goes.
 class reaper : public watcher {
 private:
     
@@ -59,10 +72,32 @@ private:
 
     std::thread* thr;
 
+    // Packet time mode.
+    bool packet_time;
+
+    // Latest packet time seen, in seconds.
+    std::atomic<unsigned long> packet_clock;
+
+    // Set if the last inline sweep stopped on the batch limit.
+    std::atomic<bool> backlog;
+
+    // Packet timestamps don't move the clock, advance_to() does.
+    bool external_clock;
+
+    // Reaps items due at 'now', at most 'max' of them.  Caller holds
+    // 'mutex'.  Returns true if the limit was reached with items still
+    // due.
+    bool reap_expired(unsigned long now, unsigned long max);
+
 public:
     void run();
 
-    reaper() { running = true; }
+    // Most items reaped in one go, bounds the time a single packet can
+    // spend on expiry.
+    static const unsigned long max_batch = 1024;
+
+    reaper() : running(true), thr(0), packet_time(false), packet_clock(0),
+	       backlog(false), external_clock(false) { }
 
     virtual void self_reaped(reapable& r) {
 	std::lock_guard<std::mutex> lock(self_mutex);
@@ -71,11 +106,61 @@ public:
 
     virtual ~reaper() {}
 
+    // Switch to packet time.  Must be called before anything is given a
+    // TTL.
+    void use_packet_time() { packet_time = true; }
+
+    bool is_packet_time() const { return packet_time; }
+
+    // In packet time mode, stops advance() moving the clock, so that the
+    // caller can move it with advance_to().  For packets handled on
+    // several threads, where the clock mustn't pass the earliest packet
+    // one of them has still to handle.
+    void use_external_clock() { external_clock = true; }
+
     virtual unsigned long get_time() {
+	if (packet_time) return packet_clock;
 	unsigned long l = ::time(0);
 	return l;
     }
 
+    // Advances the packet clock to 'tv', ignored unless in packet time
+    // mode, or if the clock is external.  Expiry runs whenever the clock moves on a second, or a
+    // previous batch was cut short.  Out-of-order timestamps don't move
+    // the clock backwards.
+    void advance(const struct timeval& tv) {
+	if (!external_clock) advance_to(tv.tv_sec);
+    }
+
+    // Advances the packet clock to 'now', in seconds, as advance().
+    void advance_to(unsigned long now) {
+
+	if (!packet_time) return;
+
+	unsigned long cur = packet_clock;
+
+	bool moved = false;
+	while (now > cur) {
+	    if (packet_clock.compare_exchange_weak(cur, now)) {
+		moved = true;
+		break;
+	    }
+	}
+
+	if (!moved && !backlog) return;
+
+	// Someone else is sweeping or setting a TTL, leave it for the next
+	// packet.
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if (!lock.owns_lock()) {
+	    backlog = true;
+	    return;
+	}
+
+	backlog = reap_expired(packet_clock, max_batch);
+
+    }
+
     virtual void set_ttl(reapable& r, unsigned long ttl) {
 	reapable* rp = &r;
 